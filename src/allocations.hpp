@@ -0,0 +1,47 @@
+#pragma once
+
+// clang-format off
+
+// Heap allocations counter, compile with -DCOUNT_ALLOCATIONS
+// Replaces the global operator new/delete, so it must be included in one translation unit per program
+// bench fails if a search allocates
+
+#include <cstddef>
+#include <cstdlib>
+#include <new>
+#include <atomic>
+#include "types.hpp"
+
+#if defined(COUNT_ALLOCATIONS)
+
+    std::atomic<u64> numAllocations = 0;
+
+    inline void* countedAlloc(std::size_t size, std::size_t alignment = 0)
+    {
+        numAllocations++;
+
+        void *ptr = alignment > alignof(std::max_align_t)
+                    ? aligned_alloc(alignment, (size + alignment - 1) / alignment * alignment)
+                    : malloc(size);
+
+        if (ptr == nullptr) throw std::bad_alloc();
+        return ptr;
+    }
+
+    void* operator new(std::size_t size) { return countedAlloc(size); }
+    void* operator new[](std::size_t size) { return countedAlloc(size); }
+    void* operator new(std::size_t size, std::align_val_t alignment) { return countedAlloc(size, (std::size_t)alignment); }
+    void* operator new[](std::size_t size, std::align_val_t alignment) { return countedAlloc(size, (std::size_t)alignment); }
+
+    void operator delete(void *ptr) noexcept { free(ptr); }
+    void operator delete[](void *ptr) noexcept { free(ptr); }
+    void operator delete(void *ptr, std::align_val_t) noexcept { free(ptr); }
+    void operator delete[](void *ptr, std::align_val_t) noexcept { free(ptr); }
+
+    inline u64 allocationsCount() { return numAllocations; }
+
+#else
+
+    inline u64 allocationsCount() { return 0; }
+
+#endif
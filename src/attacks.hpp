@@ -1,18 +1,25 @@
 #pragma once
 
 // clang-format off
+#include <array>
 #include "types.hpp"
 #include "utils.hpp"
 
+#if defined(__BMI2__) && defined(__GNUC__)
+#include <cpuid.h>
+#endif
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#endif
+
 namespace attacks {
 
 namespace internal {
     
     // private stuff
 
-    u64 pawnAttacks[2][64], knightAttacks[64], kingAttacks[64];
-
-    inline u64 pawnAttacksSlow(Square square, Color color)
+    constexpr u64 pawnAttacksSlow(Square square, Color color)
     {
         const int SQUARE_DIAGONAL_LEFT  = square + (color == Color::WHITE ? 7 : -9),
                   SQUARE_DIAGONAL_RIGHT = square + (color == Color::WHITE ? 9 : -7);
@@ -32,7 +39,7 @@ namespace internal {
         return (1ULL << SQUARE_DIAGONAL_LEFT) | (1ULL << SQUARE_DIAGONAL_RIGHT);
     }
 
-    inline u64 bishopAttacksSlow(Square sq, u64 occupied, bool excludeLastSquareEachDirection = false)
+    constexpr u64 bishopAttacksSlow(Square sq, u64 occupied, bool excludeLastSquareEachDirection = false)
     {
         u64 attacks = 0ULL;
         int r, f;
@@ -82,7 +89,7 @@ namespace internal {
         return attacks;
     }
 
-    inline u64 rookAttacksSlow(Square sq, u64 occupied, bool excludeLastSquareEachDirection = false)
+    constexpr u64 rookAttacksSlow(Square sq, u64 occupied, bool excludeLastSquareEachDirection = false)
     {
         u64 attacks = 0ULL;
         int r, f;
@@ -132,7 +139,7 @@ namespace internal {
         return attacks;
     }
 
-    const u64 BISHOP_SHIFTS[64] = {
+    constexpr u64 BISHOP_SHIFTS[64] = {
         58, 59, 59, 59, 59, 59, 59, 58, 
         59, 59, 59, 59, 59, 59, 59, 59, 
         59, 59, 57, 57, 57, 57, 59, 59, 
@@ -143,7 +150,7 @@ namespace internal {
         58, 59, 59, 59, 59, 59, 59, 58
     };
 
-    const u64 ROOK_SHIFTS[64] = {
+    constexpr u64 ROOK_SHIFTS[64] = {
         52, 53, 53, 53, 53, 53, 53, 52, 
         53, 54, 54, 54, 54, 54, 54, 53, 
         53, 54, 54, 54, 54, 54, 54, 53, 
@@ -192,97 +199,258 @@ namespace internal {
         0x489a000810200402ULL, 0x1004400080a13ULL, 0x4000011008020084ULL, 0x26002114058042ULL,
     };
 
-    u64 bishopAttacksEmptyBoard[64], 
-        rookAttacksEmptyBoard[64],
-        bishopAttacksTable[64][1ULL << 9ULL], 
-        rookAttacksTable[64][1ULL << 12ULL];
+    // Leaper attacks and slider masks are generated at compile time
 
-}
+    constexpr auto PAWN_ATTACKS = []() { // [color][square]
+        std::array<std::array<u64, 64>, 2> table = {};
+        for (Square sq = 0; sq < 64; sq++)
+        {
+            table[(int)Color::WHITE][sq] = pawnAttacksSlow(sq, Color::WHITE);
+            table[(int)Color::BLACK][sq] = pawnAttacksSlow(sq, Color::BLACK);
+        }
+        return table;
+    }();
 
-inline void init()
-{
-    using namespace internal;
+    constexpr auto KNIGHT_ATTACKS = []() { // [square]
+        std::array<u64, 64> table = {};
+        for (Square sq = 0; sq < 64; sq++)
+        {
+            u64 n = 1ULL << sq;
+            u64 h1 = ((n >> 1ULL) & 0x7f7f7f7f7f7f7f7fULL) | ((n << 1ULL) & 0xfefefefefefefefeULL);
+            u64 h2 = ((n >> 2ULL) & 0x3f3f3f3f3f3f3f3fULL) | ((n << 2ULL) & 0xfcfcfcfcfcfcfcfcULL);
+            table[sq] = (h1 << 16ULL) | (h1 >> 16ULL) | (h2 << 8ULL) | (h2 >> 8ULL);
+        }
+        return table;
+    }();
 
-    // Init pawn, king and knight attacks
-    u64 king = 1;
-    for (int square = 0; square < 64; square++)
+    constexpr auto KING_ATTACKS = []() { // [square]
+        std::array<u64, 64> table = {};
+        for (Square sq = 0; sq < 64; sq++)
+        {
+            u64 king = 1ULL << sq;
+            u64 attacks = shiftLeft(king) | shiftRight(king) | king;
+            table[sq] = (attacks | shiftUp(attacks) | shiftDown(attacks)) ^ king;
+        }
+        return table;
+    }();
+
+    // Relevant blockers of each square: slider attacks on an empty board, excluding the last square of each direction
+    constexpr auto BISHOP_MASKS = []() { // [square]
+        std::array<u64, 64> table = {};
+        for (Square sq = 0; sq < 64; sq++)
+            table[sq] = bishopAttacksSlow(sq, 0ULL, true);
+        return table;
+    }();
+
+    constexpr auto ROOK_MASKS = []() { // [square]
+        std::array<u64, 64> table = {};
+        for (Square sq = 0; sq < 64; sq++)
+            table[sq] = rookAttacksSlow(sq, 0ULL, true);
+        return table;
+    }();
+
+    // Slider attacks of all squares of both pieces in one table, at per-square offsets
+    // A square with N relevant blocker squares has 2^N entries, indexed by either
+    // its magic key (the shifts are 64 - N) or, in builds with BMI2, pext(occupancy, mask)
+    // Fixed [64][4096] and [64][512] tables would be 2.3 MB, mostly unused
+    const u64 SLIDERS_TABLE_SIZE = 5248 + 102400; // sum of 2^N over all squares, bishop + rook
+
+    u64 slidersAttacksTable[SLIDERS_TABLE_SIZE]; // 841 KB
+    u32 bishopOffsets[64], rookOffsets[64];
+
+    // Squares from each square to the edge of the board in each direction, excluding the square itself
+    // Directions 0-3 go towards higher squares, 4-7 towards lower squares
+    constexpr int RAY_DIRECTIONS[8][2] = { // { rank step, file step }
+        {1, 0}, {0, 1}, {1, 1}, {1, -1}, {-1, 0}, {0, -1}, {-1, -1}, {-1, 1}
+    };
+
+    constexpr auto RAYS = []() { // [direction][square]
+        std::array<std::array<u64, 64>, 8> table = {};
+        for (int dir = 0; dir < 8; dir++)
+            for (int sq = 0; sq < 64; sq++)
+                for (int r = sq / 8 + RAY_DIRECTIONS[dir][0], f = sq % 8 + RAY_DIRECTIONS[dir][1];
+                r >= 0 && r <= 7 && f >= 0 && f <= 7;
+                r += RAY_DIRECTIONS[dir][0], f += RAY_DIRECTIONS[dir][1])
+                    table[dir][sq] |= 1ULL << (r * 8 + f);
+        return table;
+    }();
+
+    // Square pair geometry, 0 if the squares aren't on a common rank, file or diagonal
+    // The direction opposite to dir is (dir + 4) % 8
+
+    constexpr auto BETWEEN = []() { // [square][square], squares strictly between them
+        std::array<std::array<u64, 64>, 64> table = {};
+        for (int a = 0; a < 64; a++)
+            for (int dir = 0; dir < 8; dir++)
+                for (int b = 0; b < 64; b++)
+                    if (RAYS[dir][a] & (1ULL << b))
+                        table[a][b] = RAYS[dir][a] & RAYS[(dir + 4) % 8][b];
+        return table;
+    }();
+
+    constexpr auto LINE = []() { // [square][square], the whole line through them, edge to edge
+        std::array<std::array<u64, 64>, 64> table = {};
+        for (int a = 0; a < 64; a++)
+            for (int dir = 0; dir < 8; dir++)
+                for (int b = 0; b < 64; b++)
+                    if (RAYS[dir][a] & (1ULL << b))
+                        table[a][b] = RAYS[dir][a] | RAYS[(dir + 4) % 8][a] | (1ULL << a);
+        return table;
+    }();
+
+    constexpr auto BEYOND = []() { // [square][square], squares past the second one on the ray from the first one
+        std::array<std::array<u64, 64>, 64> table = {};
+        for (int a = 0; a < 64; a++)
+            for (int dir = 0; dir < 8; dir++)
+                for (int b = 0; b < 64; b++)
+                    if (RAYS[dir][a] & (1ULL << b))
+                        table[a][b] = RAYS[dir][b];
+        return table;
+    }();
+
+    // Ray attacks up to and including the first blocker in each direction
+    // Used to fill the slider table, much faster than walking the rays square by square
+    inline u64 raysAttacks(Square sq, u64 occupied, std::array<int, 4> directions)
     {
-        // Pawn
-        pawnAttacks[0][square] = pawnAttacksSlow(square, Color::WHITE);
-        pawnAttacks[1][square] = pawnAttacksSlow(square, Color::BLACK);
-
-        // Knight
-        u64 n = 1ULL << square;
-        u64 h1 = ((n >> 1ULL) & 0x7f7f7f7f7f7f7f7fULL) | ((n << 1ULL) & 0xfefefefefefefefeULL);
-        u64 h2 = ((n >> 2ULL) & 0x3f3f3f3f3f3f3f3fULL) | ((n << 2ULL) & 0xfcfcfcfcfcfcfcfcULL);
-        knightAttacks[square] = (h1 << 16ULL) | (h1 >> 16ULL) | (h2 << 8ULL) | (h2 >> 8ULL);
-
-        // King
-        u64 attacks = shiftLeft(king) | shiftRight(king) | king;
-        attacks = (attacks | shiftUp(attacks) | shiftDown(attacks)) ^ king;
-        kingAttacks[square] = attacks;
-        king <<= 1ULL;
+        u64 attacks = 0;
+        for (int dir : directions)
+        {
+            u64 blockers = RAYS[dir][sq] & occupied;
+            attacks |= RAYS[dir][sq];
+            if (blockers > 0)
+                attacks ^= RAYS[dir][dir < 4 ? lsb(blockers) : msb(blockers)];
+        }
+        return attacks;
     }
 
-    // Init slider attacks on an empty board
-    for (Square sq = 0; sq < 64; sq++)
+    // PEXT keys instead of magic keys, selected in init() if the build has BMI2 and the CPU's pext is fast
+    bool usePext = false;
+
+    inline u64 bishopKey(Square sq, u64 blockers) 
     {
-        // last arg true = exclude last square of each direction
-        bishopAttacksEmptyBoard[sq] = bishopAttacksSlow(sq, 0ULL, true);
-        rookAttacksEmptyBoard[sq] = rookAttacksSlow(sq, 0ULL, true);
+        #if defined(__BMI2__)
+            if (usePext) return _pext_u64(blockers, BISHOP_MASKS[sq]);
+        #endif
+
+        return (blockers * BISHOP_MAGICS[sq]) >> BISHOP_SHIFTS[sq];
     }
 
-    // Init slider tables
-    for (Square sq = 0; sq < 64; sq++)
+    inline u64 rookKey(Square sq, u64 blockers) 
     {
-        // Bishop
-        u64 numBlockersArrangements = 1ULL << std::popcount(bishopAttacksEmptyBoard[sq]);
-        for (u64 n = 0; n < numBlockersArrangements; n++)
-        {
-            u64 blockersArrangement = pdep(n, bishopAttacksEmptyBoard[sq]);
-            u64 key = (blockersArrangement * BISHOP_MAGICS[sq]) >> BISHOP_SHIFTS[sq];
-            bishopAttacksTable[sq][key] = bishopAttacksSlow(sq, blockersArrangement);
-        }
+        #if defined(__BMI2__)
+            if (usePext) return _pext_u64(blockers, ROOK_MASKS[sq]);
+        #endif
+
+        return (blockers * ROOK_MAGICS[sq]) >> ROOK_SHIFTS[sq];
+    }
 
-        // Rook
-        numBlockersArrangements = 1ULL << std::popcount(rookAttacksEmptyBoard[sq]);
-        for (u64 n = 0; n < numBlockersArrangements; n++)
+    // Fill slidersAttacksTable with the current key type
+    // (blockers - mask) & mask enumerates all blockers arrangements of mask (carry-rippler)
+    inline void initSlidersAttacksTable()
+    {
+        u32 offset = 0;
+        for (Square sq = 0; sq < 64; sq++)
         {
-            u64 blockersArrangement = pdep(n, rookAttacksEmptyBoard[sq]);
-            u64 key = (blockersArrangement * ROOK_MAGICS[sq]) >> ROOK_SHIFTS[sq];
-            rookAttacksTable[sq][key] = rookAttacksSlow(sq, blockersArrangement);
+            bishopOffsets[sq] = offset;
+            assert((int)BISHOP_SHIFTS[sq] == 64 - std::popcount(BISHOP_MASKS[sq]));
+
+            u64 blockersArrangement = 0;
+            do {
+                slidersAttacksTable[offset + bishopKey(sq, blockersArrangement)] = raysAttacks(sq, blockersArrangement, {2, 3, 6, 7});
+                blockersArrangement = (blockersArrangement - BISHOP_MASKS[sq]) & BISHOP_MASKS[sq];
+            } while (blockersArrangement != 0);
+
+            offset += 1ULL << std::popcount(BISHOP_MASKS[sq]);
+
+            rookOffsets[sq] = offset;
+            assert((int)ROOK_SHIFTS[sq] == 64 - std::popcount(ROOK_MASKS[sq]));
+
+            blockersArrangement = 0;
+            do {
+                slidersAttacksTable[offset + rookKey(sq, blockersArrangement)] = raysAttacks(sq, blockersArrangement, {0, 1, 4, 5});
+                blockersArrangement = (blockersArrangement - ROOK_MASKS[sq]) & ROOK_MASKS[sq];
+            } while (blockersArrangement != 0);
+
+            offset += 1ULL << std::popcount(ROOK_MASKS[sq]);
         }
+
+        assert(offset == SLIDERS_TABLE_SIZE);
+    }
+
+    // BMI2's pext/pdep are microcoded and much slower than magics on AMD before Zen 3 (family 0x19)
+    inline bool hasFastPext()
+    {
+        #if defined(__BMI2__) && defined(__GNUC__)
+            u32 eax, ebx, ecx, edx;
+            if (!__get_cpuid(0, &eax, &ebx, &ecx, &edx)) return false;
+            bool isAmd = ebx == 0x68747541; // "Auth" of "AuthenticAMD"
+
+            __get_cpuid(1, &eax, &ebx, &ecx, &edx);
+            u32 family = ((eax >> 8) & 0xF) + ((eax >> 20) & 0xFF);
+
+            return !isAmd || family >= 0x19;
+        #elif defined(__BMI2__)
+            return true;
+        #else
+            return false;
+        #endif
     }
 
 }
 
+inline void init()
+{
+    using namespace internal;
+
+    // The slider table is filled at startup: its layout depends on the key type (magic or pext),
+    // which is picked at runtime, and at 841 KB it would exceed compilers' constexpr evaluation limits
+    usePext = hasFastPext();
+    initSlidersAttacksTable();
+}
+
 inline u64 pawnAttacks(Square square, Color color)
 {
-    return internal::pawnAttacks[(int)color][square];
+    return internal::PAWN_ATTACKS[(int)color][square];
 }
 
 inline u64 knightAttacks(Square square) 
 { 
-    return internal::knightAttacks[square];
-    }
+    return internal::KNIGHT_ATTACKS[square];
+}
 
 inline u64 kingAttacks(Square square) 
 {        
-    return internal::kingAttacks[square]; 
+    return internal::KING_ATTACKS[square]; 
+}
+
+// Use PEXT slider attacks instead of magics, returns false if this build doesn't support them
+inline bool setPext(bool value)
+{
+    #if !defined(__BMI2__)
+        if (value) return false;
+    #endif
+
+    if (value != internal::usePext)
+    {
+        internal::usePext = value;
+        internal::initSlidersAttacksTable();
+    }
+
+    return true;
 }
 
+inline bool isUsingPext() { return internal::usePext; }
+
 inline u64 bishopAttacks(Square square, u64 occupancy)
 {
     using namespace internal;
 
     // Mask to only include bits on diagonals
-    u64 blockers = occupancy & bishopAttacksEmptyBoard[square];
-
-    // Generate the key using a multiplication and right shift
-    u64 key = (blockers * BISHOP_MAGICS[square]) >> BISHOP_SHIFTS[square];
+    u64 blockers = occupancy & BISHOP_MASKS[square];
 
+    // Generate the key using pext or a multiplication and right shift
     // Return the preinitialized attack set bitboard from the table
-    return bishopAttacksTable[square][key];
+    return slidersAttacksTable[bishopOffsets[square] + bishopKey(square, blockers)];
 }
 
 inline u64 rookAttacks(Square square, u64 occupancy)
@@ -290,13 +458,11 @@ inline u64 rookAttacks(Square square, u64 occupancy)
     using namespace internal;
 
     // Mask to only include bits on rank and file
-    u64 blockers = occupancy & rookAttacksEmptyBoard[square];
-
-    // Generate the key using a multiplication and right shift
-    u64 key = (blockers * ROOK_MAGICS[square]) >> ROOK_SHIFTS[square];
+    u64 blockers = occupancy & ROOK_MASKS[square];
 
+    // Generate the key using pext or a multiplication and right shift
     // Return the preinitialized attack set bitboard from the table
-    return rookAttacksTable[square][key];
+    return slidersAttacksTable[rookOffsets[square] + rookKey(square, blockers)];
 }
 
 inline u64 queenAttacks(Square square, u64 occupancy)
@@ -304,5 +470,145 @@ inline u64 queenAttacks(Square square, u64 occupancy)
     return bishopAttacks(square, occupancy) | rookAttacks(square, occupancy);
 }
 
+inline u64 between(Square a, Square b) { return internal::BETWEEN[a][b]; }
+
+inline u64 line(Square a, Square b) { return internal::LINE[a][b]; }
+
+// Attacks of a knight, bishop, rook, queen or king on an empty board
+constexpr u64 emptyBoardAttacks(PieceType pieceType, Square square)
+{
+    using namespace internal;
+
+    u64 diagonals = RAYS[2][square] | RAYS[3][square] | RAYS[6][square] | RAYS[7][square],
+        orthogonals = RAYS[0][square] | RAYS[1][square] | RAYS[4][square] | RAYS[5][square];
+
+    switch (pieceType)
+    {
+        case PieceType::KNIGHT: return KNIGHT_ATTACKS[square];
+        case PieceType::BISHOP: return diagonals;
+        case PieceType::ROOK:   return orthogonals;
+        case PieceType::QUEEN:  return diagonals | orthogonals;
+        case PieceType::KING:   return KING_ATTACKS[square];
+        default:                return 0;
+    }
+}
+
+// Squares past 'through' on the ray from 'from' through 'through'
+// The nearest occupied one is what an x-ray through 'through' would see
+inline u64 beyond(Square from, Square through) { return internal::BEYOND[from][through]; }
+
+// X-ray attacks: squares attacked only through exactly one of the blockers that are attacked directly
+// e.g. with blockers = our pieces, the enemy sliders in the x-ray attacks from our king pin the blocker between them
+inline u64 xrayBishopAttacks(Square square, u64 occupancy, u64 blockers)
+{
+    u64 attacks = bishopAttacks(square, occupancy);
+    blockers &= attacks;
+    return attacks ^ bishopAttacks(square, occupancy ^ blockers);
+}
+
+inline u64 xrayRookAttacks(Square square, u64 occupancy, u64 blockers)
+{
+    u64 attacks = rookAttacks(square, occupancy);
+    blockers &= attacks;
+    return attacks ^ rookAttacks(square, occupancy ^ blockers);
+}
+
+// Whole board attack maps
+
+namespace internal {
+
+    const u64 FILE_A = 0x0101010101010101ULL, 
+              FILE_H = 0x8080808080808080ULL;
+
+    // Kogge-Stone occluded fill of the sliders in one direction, then one more step for the attacks
+    // Left shifts go towards higher squares, right shifts towards lower squares
+    // wrapMask excludes the file a shift wraps into
+    template <bool LEFT>
+    inline u64 koggeStoneAttacks(u64 sliders, u64 empty, int shift, u64 wrapMask)
+    {
+        auto shifted = [&](u64 bb, int n) { return LEFT ? bb << n : bb >> n; };
+
+        empty &= wrapMask;
+        sliders |= empty & shifted(sliders, shift);
+        empty &= shifted(empty, shift);
+        sliders |= empty & shifted(sliders, shift * 2);
+        empty &= shifted(empty, shift * 2);
+        sliders |= empty & shifted(sliders, shift * 4);
+
+        return shifted(sliders, shift) & wrapMask;
+    }
+
+}
+
+// Attacks of all sliders in all 8 directions
+// With AVX2, 4 directions per vector: { N, NE, NW, E } with left shifts and { S, SW, SE, W } with right shifts
+inline u64 slidersAttacks(u64 bishopsQueens, u64 rooksQueens, u64 occupancy)
+{
+    using namespace internal;
+    u64 empty = ~occupancy;
+
+    #if defined(__AVX2__)
+        const __m256i SHIFTS      = _mm256_setr_epi64x(8, 9, 7, 1),
+                      LEFT_MASKS  = _mm256_setr_epi64x(~0ULL, ~FILE_A, ~FILE_H, ~FILE_A),
+                      RIGHT_MASKS = _mm256_setr_epi64x(~0ULL, ~FILE_H, ~FILE_A, ~FILE_H);
+
+        __m256i shifts2 = _mm256_add_epi64(SHIFTS, SHIFTS), 
+                shifts4 = _mm256_add_epi64(shifts2, shifts2);
+
+        __m256i sliders = _mm256_setr_epi64x(rooksQueens, bishopsQueens, bishopsQueens, rooksQueens);
+        __m256i emptyAll = _mm256_set1_epi64x(empty);
+
+        // Higher squares
+        __m256i gen = sliders, pro = _mm256_and_si256(emptyAll, LEFT_MASKS);
+        gen = _mm256_or_si256(gen, _mm256_and_si256(pro, _mm256_sllv_epi64(gen, SHIFTS)));
+        pro = _mm256_and_si256(pro, _mm256_sllv_epi64(pro, SHIFTS));
+        gen = _mm256_or_si256(gen, _mm256_and_si256(pro, _mm256_sllv_epi64(gen, shifts2)));
+        pro = _mm256_and_si256(pro, _mm256_sllv_epi64(pro, shifts2));
+        gen = _mm256_or_si256(gen, _mm256_and_si256(pro, _mm256_sllv_epi64(gen, shifts4)));
+        __m256i attacks = _mm256_and_si256(_mm256_sllv_epi64(gen, SHIFTS), LEFT_MASKS);
+
+        // Lower squares
+        gen = sliders, pro = _mm256_and_si256(emptyAll, RIGHT_MASKS);
+        gen = _mm256_or_si256(gen, _mm256_and_si256(pro, _mm256_srlv_epi64(gen, SHIFTS)));
+        pro = _mm256_and_si256(pro, _mm256_srlv_epi64(pro, SHIFTS));
+        gen = _mm256_or_si256(gen, _mm256_and_si256(pro, _mm256_srlv_epi64(gen, shifts2)));
+        pro = _mm256_and_si256(pro, _mm256_srlv_epi64(pro, shifts2));
+        gen = _mm256_or_si256(gen, _mm256_and_si256(pro, _mm256_srlv_epi64(gen, shifts4)));
+        attacks = _mm256_or_si256(attacks, _mm256_and_si256(_mm256_srlv_epi64(gen, SHIFTS), RIGHT_MASKS));
+
+        // OR the 4 lanes
+        __m128i half = _mm_or_si128(_mm256_castsi256_si128(attacks), _mm256_extracti128_si256(attacks, 1));
+        return _mm_cvtsi128_si64(_mm_or_si128(half, _mm_unpackhi_epi64(half, half)));
+    #else
+        return koggeStoneAttacks<true>(rooksQueens, empty, 8, ~0ULL)
+               | koggeStoneAttacks<true>(bishopsQueens, empty, 9, ~FILE_A)
+               | koggeStoneAttacks<true>(bishopsQueens, empty, 7, ~FILE_H)
+               | koggeStoneAttacks<true>(rooksQueens, empty, 1, ~FILE_A)
+               | koggeStoneAttacks<false>(rooksQueens, empty, 8, ~0ULL)
+               | koggeStoneAttacks<false>(bishopsQueens, empty, 9, ~FILE_H)
+               | koggeStoneAttacks<false>(bishopsQueens, empty, 7, ~FILE_A)
+               | koggeStoneAttacks<false>(rooksQueens, empty, 1, ~FILE_H);
+    #endif
+}
+
+// All squares attacked by a side, computed setwise with no per-piece lookups
+inline u64 allAttacks(Color color, u64 pawns, u64 knights, u64 bishopsQueens, u64 rooksQueens, u64 king, u64 occupancy)
+{
+    using namespace internal;
+
+    u64 attacks = color == Color::WHITE 
+                  ? ((pawns << 7) & ~FILE_H) | ((pawns << 9) & ~FILE_A)
+                  : ((pawns >> 9) & ~FILE_H) | ((pawns >> 7) & ~FILE_A);
+
+    u64 h1 = ((knights >> 1ULL) & 0x7f7f7f7f7f7f7f7fULL) | ((knights << 1ULL) & 0xfefefefefefefefeULL);
+    u64 h2 = ((knights >> 2ULL) & 0x3f3f3f3f3f3f3f3fULL) | ((knights << 2ULL) & 0xfcfcfcfcfcfcfcfcULL);
+    attacks |= (h1 << 16ULL) | (h1 >> 16ULL) | (h2 << 8ULL) | (h2 >> 8ULL);
+
+    u64 kingRank = shiftLeft(king) | shiftRight(king) | king;
+    attacks |= (kingRank | shiftUp(kingRank) | shiftDown(kingRank)) ^ king;
+
+    return attacks | slidersAttacks(bishopsQueens, rooksQueens, occupancy);
+}
+
 }
 
@@ -0,0 +1,135 @@
+#pragma once
+
+// clang-format off
+
+#include <chrono>
+#include "nnue.hpp"
+
+namespace nnue {
+
+// FEN to CompactPosition, only the board and side to move are read
+// Returns false if the FEN is malformed
+inline bool toCompactPosition(const std::string &fen, CompactPosition &pos)
+{
+    std::array<Piece, 64> pieces;
+    pieces.fill(Piece::NONE);
+    int rank = 7, file = 0;
+    size_t i = 0;
+
+    for (; i < fen.size() && fen[i] != ' '; i++)
+    {
+        char thisChar = fen[i];
+
+        if (thisChar == '/')
+        {
+            rank--;
+            file = 0;
+        }
+        else if (thisChar >= '1' && thisChar <= '8')
+            file += thisChar - '0';
+        else if (CHAR_TO_PIECE[(u8)thisChar] != Piece::NONE && file < 8 && rank >= 0)
+            pieces[rank * 8 + file++] = CHAR_TO_PIECE[(u8)thisChar];
+        else
+            return false;
+    }
+
+    if (i + 1 >= fen.size() || (fen[i + 1] != 'w' && fen[i + 1] != 'b'))
+        return false;
+
+    pos = CompactPosition{};
+    pos.sideToMove = fen[i + 1] == 'w' ? Color::WHITE : Color::BLACK;
+    int numPieces = 0;
+
+    for (Square sq = 0; sq < 64; sq++)
+    {
+        if (pieces[sq] == Piece::NONE) continue;
+        if (numPieces == 32) return false;
+
+        pos.occupancy |= 1ULL << sq;
+        pos.setPiece(numPieces++, pieces[sq]);
+    }
+
+    return true;
+}
+
+// Evaluates every position in inputFilePath with the current net and writes "<FEN> | <eval white perspective>" lines
+// to outputFilePath, the same format as datagen without the wdl
+// Input lines can be EPD, FEN or datagen lines; lines that aren't positions are skipped
+// The file is streamed in chunks so memory stays bounded on huge files
+inline void evalBatch(std::string inputFilePath, std::string outputFilePath, int numThreads = 1)
+{
+    const u64 CHUNK_SIZE = 1ULL << 16;
+
+    std::ifstream inputFile(inputFilePath);
+    if (!inputFile.is_open())
+    {
+        std::cout << "Error opening " << inputFilePath << std::endl;
+        return;
+    }
+
+    std::ofstream outputFile(outputFilePath);
+    if (!outputFile.is_open())
+    {
+        std::cout << "Error creating " << outputFilePath << std::endl;
+        return;
+    }
+
+    std::vector<std::string> fens;
+    std::vector<CompactPosition> positions;
+    std::vector<i32> evals(CHUNK_SIZE);
+    fens.reserve(CHUNK_SIZE);
+    positions.reserve(CHUNK_SIZE);
+
+    u64 numPositions = 0, numSkipped = 0;
+    double evalSeconds = 0;
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    std::string line, outputBuffer;
+
+    while (inputFile.good())
+    {
+        fens.clear();
+        positions.clear();
+
+        while (fens.size() < CHUNK_SIZE && std::getline(inputFile, line))
+        {
+            line = line.substr(0, line.find('|'));
+            std::vector<std::string> tokens = splitString(line, ' ');
+            CompactPosition pos;
+
+            if (tokens.size() < 4 || !toCompactPosition(tokens[0] + " " + tokens[1], pos))
+            {
+                numSkipped += tokens.size() > 0;
+                continue;
+            }
+
+            fens.push_back(tokens[0] + " " + tokens[1] + " " + tokens[2] + " " + tokens[3]);
+            positions.push_back(pos);
+        }
+
+        std::chrono::steady_clock::time_point evalStart = std::chrono::steady_clock::now();
+        mainNet.evaluateBatch(positions.data(), evals.data(), positions.size(), numThreads);
+        evalSeconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - evalStart).count();
+
+        outputBuffer.clear();
+        for (u64 i = 0; i < positions.size(); i++)
+        {
+            i32 eval = positions[i].sideToMove == Color::WHITE ? evals[i] : -evals[i];
+            outputBuffer += fens[i] + " | " + std::to_string(eval) + "\n";
+        }
+        outputFile << outputBuffer;
+
+        numPositions += positions.size();
+    }
+
+    double totalSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    std::cout << "Evaluated " << numPositions << " positions"
+              << " (" << numSkipped << " lines skipped)"
+              << " with " << numThreads << " threads"
+              << " in " << totalSeconds << "s"
+              << ", eval " << (u64)(numPositions / std::max(evalSeconds, 1e-9)) << " positions/s"
+              << ", total " << (u64)(numPositions / std::max(totalSeconds, 1e-9)) << " positions/s"
+              << std::endl;
+}
+
+}
@@ -70,11 +70,17 @@ inline void bench(u8 depth = DEFAULT_DEPTH)
     u64 totalNodes = 0;
     std::chrono::steady_clock::time_point start =  std::chrono::steady_clock::now();
 
+    u64 searchAllocations = 0;
+
     uci::ucinewgame();
     for (int i = 0; i < FENS.size(); i++)
     {
         board = Board(FENS[i]);
+
+        u64 allocationsBefore = allocationsCount();
         search::search(depth);
+        searchAllocations += allocationsCount() - allocationsBefore;
+
         totalNodes += search::nodes;
         uci::ucinewgame();
     }
@@ -90,6 +96,294 @@ inline void bench(u8 depth = DEFAULT_DEPTH)
 
     board = Board(originalFen);
     uci::outputSearchInfo = true;
+
+    #if defined(COUNT_ALLOCATIONS)
+        std::cout << "bench heap allocations in search " << searchAllocations << std::endl;
+        if (searchAllocations > 0) 
+        {
+            std::cout << "bench failed: the search allocated" << std::endl;
+            exit(1);
+        }
+    #endif
+}
+
+// A side's pieces, for whole board attack maps
+struct SidePieces {
+    Color color;
+    u64 pawns, knights, bishopsQueens, rooksQueens, king, occupancy;
+};
+
+// Whole board attack map by looping over the pieces and looking up each one's attacks
+inline u64 allAttacksPerPiece(SidePieces side)
+{
+    u64 attacks = 0;
+    for (u64 pawns = side.pawns; pawns > 0;) attacks |= attacks::pawnAttacks(poplsb(pawns), side.color);
+    for (u64 knights = side.knights; knights > 0;) attacks |= attacks::knightAttacks(poplsb(knights));
+    for (u64 bishops = side.bishopsQueens; bishops > 0;) attacks |= attacks::bishopAttacks(poplsb(bishops), side.occupancy);
+    for (u64 rooks = side.rooksQueens; rooks > 0;) attacks |= attacks::rookAttacks(poplsb(rooks), side.occupancy);
+    return attacks | attacks::kingAttacks(lsb(side.king));
+}
+
+// Slider attacks microbenchmark, on the slider squares and occupancies of the bench positions and their children
+// Lookups/s alone, then with a random access to a 64 MB buffer every 4 lookups (like TT probes),
+// which competes with the attack tables for the caches
+// Then whole board attack maps/s of attacks::allAttacks() (Kogge-Stone fills) vs the per-piece lookups loop
+inline void attacksBench(u64 numLookups = 50'000'000)
+{
+    std::vector<std::pair<Square, u64>> bishopQueries, rookQueries;
+    std::vector<SidePieces> sides;
+
+    auto addQueries = [&](BasicBoard<Tracking::NONE> &board) {
+        u64 bishops = board.getBitboard(PieceType::BISHOP) | board.getBitboard(PieceType::QUEEN);
+        u64 rooks = board.getBitboard(PieceType::ROOK) | board.getBitboard(PieceType::QUEEN);
+        while (bishops > 0) bishopQueries.push_back({ poplsb(bishops), board.occupancy() });
+        while (rooks > 0) rookQueries.push_back({ poplsb(rooks), board.occupancy() });
+
+        for (Color color : {Color::WHITE, Color::BLACK})
+            sides.push_back({ color,
+                              board.getBitboard(color, PieceType::PAWN),
+                              board.getBitboard(color, PieceType::KNIGHT),
+                              board.getBitboard(color, PieceType::BISHOP) | board.getBitboard(color, PieceType::QUEEN),
+                              board.getBitboard(color, PieceType::ROOK) | board.getBitboard(color, PieceType::QUEEN),
+                              board.getBitboard(color, PieceType::KING),
+                              board.occupancy() });
+    };
+
+    for (std::string fen : FENS)
+    {
+        BasicBoard<Tracking::NONE> board = BasicBoard<Tracking::NONE>(fen);
+        addQueries(board);
+
+        MovesList moves = board.pseudolegalMoves();
+        for (int i = 0; i < moves.size(); i++)
+        {
+            if (!board.makeMove(moves[i])) continue;
+            addQueries(board);
+            board.undoMove();
+        }
+    }
+
+    std::mt19937_64 gen(12345);
+    std::shuffle(bishopQueries.begin(), bishopQueries.end(), gen);
+    std::shuffle(rookQueries.begin(), rookQueries.end(), gen);
+
+    const u64 BUFFER_SIZE = (64ULL << 20) / sizeof(u64);
+    std::vector<u64> buffer(BUFFER_SIZE, 1);
+
+    for (bool withCachePressure : {false, true})
+    {
+        u64 sink = 0, bufferIdx = 0;
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+        for (u64 i = 0; i < numLookups; i++)
+        {
+            auto [bishopSquare, bishopOccupancy] = bishopQueries[i % bishopQueries.size()];
+            auto [rookSquare, rookOccupancy] = rookQueries[i % rookQueries.size()];
+            sink += attacks::bishopAttacks(bishopSquare, bishopOccupancy) ^ attacks::rookAttacks(rookSquare, rookOccupancy);
+
+            if (withCachePressure && i % 4 == 0)
+            {
+                bufferIdx = (bufferIdx * 6364136223846793005ULL + 1442695040888963407ULL + sink) % BUFFER_SIZE;
+                sink += buffer[bufferIdx]++;
+            }
+        }
+
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+        std::cout << "attacks bench " << (attacks::isUsingPext() ? "pext" : "magics")
+                  << (withCachePressure ? " with cache pressure" : "")
+                  << " lookups/s " << (u64)(numLookups * 2 / seconds)
+                  << " (" << bishopQueries.size() + rookQueries.size() << " queries)"
+                  << std::endl;
+
+        volatile u64 result = sink; // keep the lookups
+        (void)result;
+    }
+
+    u64 mismatches = 0;
+    for (SidePieces &side : sides)
+        mismatches += attacks::allAttacks(side.color, side.pawns, side.knights, side.bishopsQueens, side.rooksQueens, side.king, side.occupancy) 
+                      != allAttacksPerPiece(side);
+
+    const u64 NUM_MAPS = numLookups / 10;
+
+    for (bool koggeStone : {true, false})
+    {
+        u64 sink = 0;
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+        for (u64 i = 0; i < NUM_MAPS; i++)
+        {
+            SidePieces &side = sides[i % sides.size()];
+            sink += koggeStone 
+                    ? attacks::allAttacks(side.color, side.pawns, side.knights, side.bishopsQueens, side.rooksQueens, side.king, side.occupancy)
+                    : allAttacksPerPiece(side);
+        }
+
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+        std::cout << "attack maps bench " << (koggeStone ? "kogge-stone" : "per piece")
+                  #if defined(__AVX2__)
+                  << (koggeStone ? " avx2" : "")
+                  #endif
+                  << " maps/s " << (u64)(NUM_MAPS / seconds)
+                  << " (" << sides.size() << " sides, " << mismatches << " mismatches)"
+                  << std::endl;
+
+        volatile u64 result = sink;
+        (void)result;
+    }
+}
+
+// The bench positions and the positions after each of their legal moves
+inline std::vector<std::string> benchPositionsAndChildren()
+{
+    std::vector<std::string> fens;
+    for (std::string fen : FENS)
+    {
+        BasicBoard<Tracking::NONE> board = BasicBoard<Tracking::NONE>(fen);
+        fens.push_back(board.fen());
+
+        MovesList moves = board.pseudolegalMoves();
+        for (int i = 0; i < moves.size(); i++)
+        {
+            if (!board.makeMove(moves[i])) continue;
+            fens.push_back(board.fen());
+            board.undoMove();
+        }
+    }
+
+    return fens;
+}
+
+// FEN parsing and writing throughput, on the bench positions and their children
+// A board is reused, so neither parsing nor writing should allocate
+inline void fenBench(u64 numFens = 5'000'000)
+{
+    std::vector<std::string> fens = benchPositionsAndChildren();
+
+    BasicBoard<Tracking::NONE> board = BasicBoard<Tracking::NONE>(START_FEN);
+    char buffer[board.MAX_FEN_LENGTH];
+    u64 sink = 0, mismatches = 0;
+
+    u64 allocationsBefore = allocationsCount();
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+    for (u64 i = 0; i < numFens; i++)
+    {
+        board.setFen(fens[i % fens.size()]);
+        sink += board.occupancy();
+    }
+
+    double parseSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    start = std::chrono::steady_clock::now();
+
+    for (u64 i = 0; i < numFens; i++)
+    {
+        board.setFen(fens[i % fens.size()]);
+        sink += board.writeFen(buffer) + buffer[i % 16];
+    }
+
+    // Writing time is parse and write minus parse
+    double writeSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count() - parseSeconds;
+    u64 allocations = allocationsCount() - allocationsBefore;
+
+    // Round trip
+    for (std::string &fen : fens)
+    {
+        board.setFen(fen);
+        mismatches += std::string_view(buffer, board.writeFen(buffer)) != fen;
+    }
+
+    std::cout << "fen bench parse fens/s " << (u64)(numFens / parseSeconds)
+              << ", write fens/s " << (u64)(numFens / writeSeconds)
+              << " (" << fens.size() << " fens, " << mismatches << " round trip mismatches"
+              #if defined(COUNT_ALLOCATIONS)
+              << ", " << allocations << " heap allocations"
+              #endif
+              << ")" << std::endl;
+
+    volatile u64 result = sink;
+    (void)result;
+    (void)allocations;
+}
+
+// SEE throughput on the noisy moves of the bench positions and their children:
+// each SEE on its own vs batched per node, sharing the attackers of each target square
+inline void seeBench(int repetitions = 200)
+{
+    std::string originalFen = board.fen();
+    std::vector<std::string> fens = benchPositionsAndChildren();
+
+    u64 numSEEs = 0, mismatches = 0, sink = 0;
+    double singleSeconds = 0, batchedSeconds = 0;
+
+    for (std::string &fen : fens)
+    {
+        board.setFen(fen);
+        MovesList moves = board.pseudolegalMoves(true, false); // noisy moves, as in qsearch
+
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        for (int r = 0; r < repetitions; r++)
+            for (int i = 0; i < moves.size(); i++)
+                sink += see::SEE(board, moves[i]);
+
+        singleSeconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        start = std::chrono::steady_clock::now();
+
+        for (int r = 0; r < repetitions; r++)
+        {
+            see::NodeAttackers seeAttackers = see::NodeAttackers(board);
+            for (int i = 0; i < moves.size(); i++)
+                sink += see::SEE(board, seeAttackers, moves[i]);
+        }
+
+        batchedSeconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+        see::NodeAttackers seeAttackers = see::NodeAttackers(board);
+        for (int i = 0; i < moves.size(); i++)
+            for (i32 threshold : {-300, 0, 300})
+                mismatches += see::SEE(board, moves[i], threshold) != see::SEE(board, seeAttackers, moves[i], threshold);
+
+        numSEEs += (u64)moves.size() * repetitions;
+    }
+
+    board = Board(originalFen);
+
+    std::cout << "see bench single SEEs/s " << (u64)(numSEEs / singleSeconds)
+              << ", batched SEEs/s " << (u64)(numSEEs / batchedSeconds)
+              << " (" << numSEEs / repetitions << " noisy moves in " << fens.size() << " positions, " 
+              << mismatches << " mismatches)" << std::endl;
+
+    volatile u64 result = sink;
+    (void)result;
 }
 
-}
\ No newline at end of file
+// Startup steps timed in main(), printed by the uci command "startup"
+// Tables generated at compile time don't appear here, they're in the binary's read-only data
+std::vector<std::pair<std::string, u64>> startupMicroseconds;
+
+template <typename F>
+inline void timeStartupStep(std::string stepName, F step)
+{
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    step();
+    u64 microseconds = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start).count();
+    startupMicroseconds.push_back({ stepName, microseconds });
+}
+
+inline void printStartup()
+{
+    u64 totalMicroseconds = 0;
+    std::string steps;
+
+    for (auto [stepName, microseconds] : startupMicroseconds)
+    {
+        totalMicroseconds += microseconds;
+        steps += (steps.empty() ? "" : ", ") + stepName + " " + std::to_string(microseconds) + " us";
+    }
+
+    std::cout << "startup " << totalMicroseconds << " us (" << steps << ")" << std::endl;
+}
+
+}
@@ -11,6 +11,115 @@
 #include "attacks.hpp"
 #include "nnue.hpp"
 
+// Zobrist keys, generated at compile time with mt19937_64 seeded with 12345
+// Order: color to move, then each piece type and square for white then black, then the en passant files
+struct ZobristKeys
+{
+    u64 colorToMove = 0;
+    u64 pieces[2][6][64] = {}; // [color][pieceType][square]
+    u64 enPassantFiles[8] = {};
+};
+
+constexpr ZobristKeys ZOBRIST = []() {
+    ConstexprMt19937_64 gen(12345);
+    ZobristKeys keys;
+
+    keys.colorToMove = gen();
+
+    for (int pt = 0; pt < 6; pt++)
+        for (int sq = 0; sq < 64; sq++)
+        {
+            keys.pieces[(int)Color::WHITE][pt][sq] = gen();
+            keys.pieces[(int)Color::BLACK][pt][sq] = gen();
+        }
+
+    for (int file = 0; file < 8; file++)
+        keys.enPassantFiles[file] = gen();
+
+    return keys;
+}();
+
+// Cuckoo tables for upcoming repetition detection (Marcel van Kervinck's method)
+// For every reversible move of a knight, bishop, rook, queen or king between two squares, 
+// the zobrist key difference it causes and its squares, cuckoo hashed with 2 hash functions
+struct CuckooTable
+{
+    constexpr static int SIZE = 8192;
+
+    u64 keys[SIZE] = {};
+    std::array<Square, 2> squares[SIZE] = {};
+    int numMoves = 0;
+
+    constexpr static int h1(u64 key) { return key & (SIZE - 1); }
+
+    constexpr static int h2(u64 key) { return (key >> 16) & (SIZE - 1); }
+};
+
+constexpr CuckooTable CUCKOO = []() {
+    CuckooTable table;
+
+    for (int color = 0; color < 2; color++)
+        for (PieceType pt : { PieceType::KNIGHT, PieceType::BISHOP, PieceType::ROOK, PieceType::QUEEN, PieceType::KING })
+            for (Square sq1 = 0; sq1 < 64; sq1++)
+                for (Square sq2 = sq1 + 1; sq2 < 64; sq2++)
+                {
+                    if ((attacks::emptyBoardAttacks(pt, sq1) & (1ULL << sq2)) == 0) continue;
+
+                    u64 key = ZOBRIST.pieces[color][(int)pt][sq1] ^ ZOBRIST.pieces[color][(int)pt][sq2] ^ ZOBRIST.colorToMove;
+                    std::array<Square, 2> squares = { sq1, sq2 };
+
+                    // Insert, kicking out the entry in the way to its other slot until an empty slot is found
+                    int i = CuckooTable::h1(key);
+                    while (true)
+                    {
+                        std::swap(table.keys[i], key);
+                        std::swap(table.squares[i], squares);
+                        if (key == 0) break;
+                        i = i == CuckooTable::h1(key) ? CuckooTable::h2(key) : CuckooTable::h1(key);
+                    }
+
+                    table.numMoves++;
+                }
+
+    return table;
+}();
+
+static_assert(CUCKOO.numMoves == 3668);
+
+// Copy-make (compile with -DCOPY_MAKE): each makeMove() copies the whole Position onto a stack
+// and undoMove() just pops it, instead of saving a BoardState and reversing the move's changes
+#if defined(COPY_MAKE)
+    const bool USE_COPY_MAKE = true;
+#else
+    const bool USE_COPY_MAKE = false;
+#endif
+
+// Everything that changes when a move is made
+struct alignas(64) Position
+{
+    std::array<Piece, 64> pieces;                      // [square]
+    std::array<std::array<u64, 6>, 2> piecesBitboards; // [color][pieceType]
+    std::array<u64, 2> colorBitboard;                  // [color]
+    u64 castlingRights;
+    u64 zobristHash;
+
+    // Enemy pieces giving check and our pieces pinned to our king
+    // Calculated together with inCheckCached, only valid if inCheckCached != -1
+    u64 checkers = 0, pinned = 0;
+
+    Color colorToMove;
+    Square enPassantSquare;
+    u16 pliesSincePawnMoveOrCapture, currentMoveCounter;
+    i8 inCheckCached = -1; // -1 means invalid (need to calculate inCheck())
+
+    // Copy-make only: the move that led to this position (BoardState has these in make/undo)
+    Move move = MOVE_NONE;
+    PieceType pieceTypeMoved = PieceType::NONE;
+    Piece capturedPiece = Piece::NONE;
+};
+
+static_assert(sizeof(Position) == 256); // 4 cache lines
+
 struct BoardState
 {
     public:
@@ -23,9 +132,12 @@ struct BoardState
     PieceType pieceTypeMoved;
     Piece capturedPiece;
     i8 inCheckCached;
+    u64 checkers, pinned;
+
+    BoardState() = default;
 
     inline BoardState(u64 zobristHash, u64 castlingRights, Square enPassantSquare, u16 pliesSincePawnMoveOrCapture, 
-                      Move move, PieceType pieceTypeMoved, Piece capturedPiece, i8 inCheckCached)
+                      Move move, PieceType pieceTypeMoved, Piece capturedPiece, i8 inCheckCached, u64 checkers, u64 pinned)
     {
         this->zobristHash = zobristHash;
         this->castlingRights = castlingRights;
@@ -35,232 +147,250 @@ struct BoardState
         this->pieceTypeMoved = pieceTypeMoved;
         this->capturedPiece = capturedPiece;
         this->inCheckCached = inCheckCached;
+        this->checkers = checkers;
+        this->pinned = pinned;
     }
 
 };
 
-class Board
+// What a board keeps up to date on each move, besides the position itself
+// The main board tracks everything, perft and datagen openings don't pay for what they don't use
+enum class Tracking : i8
 {
-    private:
+    NONE = 0,          // Zobrist hash is not valid (0), NNUE accumulators untouched
+    HASH = 1,          // Zobrist hash, NNUE accumulators untouched
+    HASH_AND_NNUE = 2  // Zobrist hash and the NNUE accumulators (search)
+};
 
-    std::array<Piece, 64> pieces; // [square]
-    
-    std::array<u64, 2> colorBitboard;                  // [color]
-    std::array<std::array<u64, 6>, 2> piecesBitboards; // [color][pieceType]
+template <Tracking TRACKING>
+class BasicBoard
+{
+    private:
 
-    u64 castlingRights;
+    constexpr static bool TRACK_HASH = TRACKING != Tracking::NONE,
+                          TRACK_NNUE = TRACKING == Tracking::HASH_AND_NNUE;
 
-    Color colorToMove;
-    Square enPassantSquare;
-    u16 pliesSincePawnMoveOrCapture, currentMoveCounter;
+    // Make/undo: the current position, and what's needed to undo each move made
+    Position position;
+    FixedStack<BoardState> states;
 
-    std::vector<BoardState> states;
+    // Copy-make: the positions since the FEN, positions.back() is the current one
+    FixedStack<Position> positions;
 
-    u64 zobristHash;
-    static inline u64 zobristPieces[2][6][64],
-                      zobristColorToMove,
-                      zobristEnPassantFiles[8];
-    static inline bool zobristInitialized = false;
+    inline Position &pos() { 
+        return USE_COPY_MAKE ? positions.back() : position; 
+    }
 
-    i8 inCheckCached = -1; // -1 means invalid (need to calculate inCheck())
+    // Number of moves made since the FEN
+    inline int numMovesMade() { 
+        return USE_COPY_MAKE ? (int)positions.size() - 1 : (int)states.size(); 
+    }
 
-    bool perft = false; // In perft, dont update zobrist hash nor nnue accumulator
+    // Zobrist hash of the position after the first n moves made since the FEN
+    inline u64 zobristHashAfter(int n) { 
+        return USE_COPY_MAKE ? positions[n].zobristHash : states[n].zobristHash; 
+    }
 
     public:
 
-    Board() = default;
+    BasicBoard() = default;
 
-    inline Board(std::string fen, bool perft = false)
+    inline BasicBoard(std::string_view fen)
     {
-        if (!zobristInitialized) initZobrist();
+        if (USE_COPY_MAKE)
+            positions = FixedStack<Position>(STACK_CAPACITY);
+        else
+            states = FixedStack<BoardState>(STACK_CAPACITY);
+
+        setFen(fen);
+    }
 
-        states.clear();
-        states.reserve(256);
+    // Sets the position from a FEN, the move counters are optional, and clears the moves made
+    // Doesn't allocate, so a board can be reused to parse many FENs
+    inline void setFen(std::string_view fen)
+    {
+        if (USE_COPY_MAKE)
+        {
+            positions.clear();
+            positions.push_back(Position());
+        }
+        else
+            states.clear();
 
-        this->perft = perft;
-        inCheckCached = -1;
+        pos().inCheckCached = -1;
 
-        nnue::reset();
+        if constexpr (TRACK_NNUE) nnue::reset();
 
         parseFen(fen);
     }
 
     private:
 
-    inline void parseFen(std::string &fen)
+    inline void parseFen(std::string_view fen)
     {
-        trim(fen);
-        std::vector<std::string> fenSplit = splitString(fen, ' ');
+        size_t idx = 0;
+        std::string_view fenRows = nextToken(fen, idx),
+                         strColorToMove = nextToken(fen, idx),
+                         strCastlingRights = nextToken(fen, idx),
+                         strEnPassantSquare = nextToken(fen, idx),
+                         strPliesSincePawnMoveOrCapture = nextToken(fen, idx),
+                         strMoveCounter = nextToken(fen, idx);
 
-        colorToMove = fenSplit[1] == "b" ? Color::BLACK : Color::WHITE;
-        zobristHash = colorToMove == Color::WHITE ? 0 : zobristColorToMove;
+        pos().colorToMove = strColorToMove == "b" ? Color::BLACK : Color::WHITE;
+        pos().zobristHash = TRACK_HASH && pos().colorToMove == Color::BLACK ? ZOBRIST.colorToMove : 0;
 
-        std::string strEnPassantSquare = fenSplit[3];
-        enPassantSquare = strEnPassantSquare == "-" ? SQUARE_NONE : strToSquare(strEnPassantSquare);
-        if (enPassantSquare != SQUARE_NONE)
-            zobristHash ^= zobristEnPassantFiles[(int)squareFile(enPassantSquare)];
+        pos().enPassantSquare = strEnPassantSquare.size() == 2 ? strToSquare(strEnPassantSquare) : SQUARE_NONE;
+        if (TRACK_HASH && pos().enPassantSquare != SQUARE_NONE)
+            pos().zobristHash ^= ZOBRIST.enPassantFiles[(int)squareFile(pos().enPassantSquare)];
 
-        pliesSincePawnMoveOrCapture = fenSplit.size() >= 5 ? stoi(fenSplit[4]) : 0;
-        currentMoveCounter = fenSplit.size() >= 6 ? stoi(fenSplit[5]) : 1;
+        pos().pliesSincePawnMoveOrCapture = parseInt<u16>(strPliesSincePawnMoveOrCapture, 0);
+        pos().currentMoveCounter = parseInt<u16>(strMoveCounter, 1);
 
         // Parse fen rows (pieces)
 
-        for (int sq = 0; sq < 64; sq++)
-            pieces[sq] = Piece::NONE;
-
-        colorBitboard[(int)Color::WHITE] = colorBitboard[(int)Color::BLACK] = 0;
-
-        for (int pt = 0; pt < 6; pt++)
-            piecesBitboards[(int)Color::WHITE][pt] = piecesBitboards[(int)Color::BLACK][pt] = 0;
+        pos().pieces.fill(Piece::NONE);
+        pos().colorBitboard = {};
+        pos().piecesBitboards = {};
 
-        std::string fenRows = fenSplit[0];
         int currentRank = 7, currentFile = 0; // iterate ranks from top to bottom, files from left to right
 
-        for (int i = 0; i < fenRows.length(); i++)
+        for (char thisChar : fenRows)
         {
-            char thisChar = fenRows[i];
             if (thisChar == '/')
             {
                 currentRank--;
                 currentFile = 0;
             }
-            else if (isdigit(thisChar))
-                currentFile += charToInt(thisChar);
-            else
+            else if (thisChar >= '1' && thisChar <= '8')
+                currentFile += thisChar - '0';
+            else if (currentRank >= 0 && currentFile < 8)
             {
                 Square sq = currentRank * 8 + currentFile;
-                Piece piece = CHAR_TO_PIECE[thisChar];
+                Piece piece = CHAR_TO_PIECE[(u8)thisChar];
+                if (piece == Piece::NONE) continue;
+
                 placePiece(sq, piece);
-                if (!perft) 
-                {
-                    Color color = pieceColor(piece);
-                    PieceType pt = pieceToPieceType(piece);
-                    zobristHash ^= zobristPieces[(int)color][(int)pt][sq];
-                    nnue::currentAccumulator->update(color, pt, sq, true);
-                }
+
+                Color color = pieceColor(piece);
+                PieceType pt = pieceToPieceType(piece);
+                if constexpr (TRACK_HASH) pos().zobristHash ^= ZOBRIST.pieces[(int)color][(int)pt][sq];
+                if constexpr (TRACK_NNUE) nnue::update(color, pt, sq, true);
+
                 currentFile++;
             }
         }
 
-        // Parse castling rights
-
-        castlingRights = 0;
-        std::string fenCastlingRights = fenSplit[2];
+        // Parse castling rights ("-" has none of these)
 
-        if (fenCastlingRights == "-") return;
+        pos().castlingRights = 0;
 
-        for (int i = 0; i < fenCastlingRights.length(); i++)
+        for (char thisChar : strCastlingRights)
         {
-            char thisChar = fenCastlingRights[i];
+            if (thisChar != 'K' && thisChar != 'Q' && thisChar != 'k' && thisChar != 'q') continue;
+
             Color color = isupper(thisChar) ? Color::WHITE : Color::BLACK;
             int castlingRight = thisChar == 'K' || thisChar == 'k' ? CASTLE_SHORT : CASTLE_LONG;
-            castlingRights |= CASTLING_MASKS[(int)color][castlingRight];
+            pos().castlingRights |= CASTLING_MASKS[(int)color][castlingRight];
         }
         
-        zobristHash ^= castlingRights;
-    }
-
-    inline static void initZobrist()
-    {
-        std::mt19937_64 gen(12345); // 64 bit Mersenne Twister rng with seed 12345
-        std::uniform_int_distribution<u64> distribution; // distribution(gen) returns random u64
-        
-        zobristColorToMove = distribution(gen);
-
-        for (int pt = 0; pt < 6; pt++)
-            for (int sq = 0; sq < 64; sq++)
-            {
-                zobristPieces[(int)Color::WHITE][pt][sq] = distribution(gen);
-                zobristPieces[(int)Color::BLACK][pt][sq] = distribution(gen);
-            }
-
-        for (int file = 0; file < 8; file++)
-            zobristEnPassantFiles[file] = distribution(gen);
-
-        zobristInitialized = true;
+        if constexpr (TRACK_HASH) pos().zobristHash ^= pos().castlingRights;
     }
 
     inline void placePiece(Square square, Piece piece)
     {
         if (piece == Piece::NONE) return;
 
-        pieces[square] = piece;
+        pos().pieces[square] = piece;
         int color = (int)pieceColor(piece);
         int pieceType = (int)pieceToPieceType(piece);
         u64 squareBit = (1ULL << square);
 
-        colorBitboard[color] |= squareBit;
-        piecesBitboards[color][pieceType] |= squareBit;
+        pos().colorBitboard[color] |= squareBit;
+        pos().piecesBitboards[color][pieceType] |= squareBit;
     }
 
     inline void removePiece(Square square)
     {
-        if (pieces[square] == Piece::NONE) return;
+        if (pos().pieces[square] == Piece::NONE) return;
 
-        Piece piece = pieces[square];
-        pieces[square] = Piece::NONE;
+        Piece piece = pos().pieces[square];
+        pos().pieces[square] = Piece::NONE;
         int color = (int)pieceColor(piece);
         int pieceType = (int)pieceToPieceType(piece);
         u64 squareBit = 1ULL << square;
 
-        colorBitboard[color] ^= squareBit;
-        piecesBitboards[color][pieceType] ^= squareBit;
+        pos().colorBitboard[color] ^= squareBit;
+        pos().piecesBitboards[color][pieceType] ^= squareBit;
     }
 
     public:
 
-    inline std::string fen()
+    // Longest FEN: 64 chars for the pieces and slashes, side to move, castling, en passant and the 2 counters
+    constexpr static int MAX_FEN_LENGTH = 96;
+
+    // Writes the FEN to out, which must have room for MAX_FEN_LENGTH chars
+    // Returns its length, out isn't null terminated
+    inline int writeFen(char *out)
     {
-        std::string myFen = "";
+        char *start = out;
 
         for (int rank = 7; rank >= 0; rank--)
         {
             int emptySoFar = 0;
             for (int file = 0; file < 8; file++)
             {
-                Square square = rank * 8 + file;
-                Piece piece = pieces[square];
+                Piece piece = pos().pieces[rank * 8 + file];
                 if (piece == Piece::NONE)
                 {
                     emptySoFar++;
                     continue;
                 }
                 if (emptySoFar > 0) 
-                    myFen += std::to_string(emptySoFar);
-                myFen += std::string(1, PIECE_TO_CHAR[piece]);
+                    *out++ = '0' + emptySoFar;
+                *out++ = PIECE_TO_CHAR[(int)piece];
                 emptySoFar = 0;
             }
             if (emptySoFar > 0) 
-                myFen += std::to_string(emptySoFar);
-            myFen += "/";
+                *out++ = '0' + emptySoFar;
+            *out++ = rank > 0 ? '/' : ' ';
         }
 
-        myFen.pop_back(); // remove last '/'
-
-        myFen += colorToMove == Color::BLACK ? " b " : " w ";
-
-        std::string strCastlingRights = "";
-        if ((castlingRights & CASTLING_MASKS[(int)Color::WHITE][CASTLE_SHORT]) > 0) 
-            strCastlingRights += "K";
-        if ((castlingRights & CASTLING_MASKS[(int)Color::WHITE][CASTLE_LONG]) > 0) 
-            strCastlingRights += "Q";
-        if ((castlingRights & CASTLING_MASKS[(int)Color::BLACK][CASTLE_SHORT]) > 0) 
-            strCastlingRights += "k";
-        if ((castlingRights & CASTLING_MASKS[(int)Color::BLACK][CASTLE_LONG]) > 0) 
-            strCastlingRights += "q";
-
-        if (strCastlingRights.size() == 0) 
-            strCastlingRights = "-";
+        *out++ = pos().colorToMove == Color::BLACK ? 'b' : 'w';
+        *out++ = ' ';
+
+        char *castlingRightsStart = out;
+        if ((pos().castlingRights & CASTLING_MASKS[(int)Color::WHITE][CASTLE_SHORT]) > 0) 
+            *out++ = 'K';
+        if ((pos().castlingRights & CASTLING_MASKS[(int)Color::WHITE][CASTLE_LONG]) > 0) 
+            *out++ = 'Q';
+        if ((pos().castlingRights & CASTLING_MASKS[(int)Color::BLACK][CASTLE_SHORT]) > 0) 
+            *out++ = 'k';
+        if ((pos().castlingRights & CASTLING_MASKS[(int)Color::BLACK][CASTLE_LONG]) > 0) 
+            *out++ = 'q';
+        if (out == castlingRightsStart) 
+            *out++ = '-';
+        *out++ = ' ';
+
+        if (pos().enPassantSquare == SQUARE_NONE)
+            *out++ = '-';
+        else
+        {
+            *out++ = 'a' + (int)squareFile(pos().enPassantSquare);
+            *out++ = '1' + (int)squareRank(pos().enPassantSquare);
+        }
+        *out++ = ' ';
 
-        myFen += strCastlingRights;
+        out = std::to_chars(out, start + MAX_FEN_LENGTH, pos().pliesSincePawnMoveOrCapture).ptr;
+        *out++ = ' ';
+        out = std::to_chars(out, start + MAX_FEN_LENGTH, pos().currentMoveCounter).ptr;
 
-        std::string strEnPassantSquare = enPassantSquare == SQUARE_NONE ? "-" : SQUARE_TO_STR[enPassantSquare];
-        myFen += " " + strEnPassantSquare;
-        
-        myFen += " " + std::to_string(pliesSincePawnMoveOrCapture);
-        myFen += " " + std::to_string(currentMoveCounter);
+        return out - start;
+    }
 
-        return myFen;
+    inline std::string fen()
+    {
+        char buffer[MAX_FEN_LENGTH];
+        return std::string(buffer, writeFen(buffer));
     }
 
     inline void printBoard()
@@ -272,9 +402,9 @@ class Board
             for (Square j = 0; j < 8; j++)
             {
                 int square = i * 8 + j;
-                str += pieces[square] == Piece::NONE 
+                str += pos().pieces[square] == Piece::NONE 
                        ? "." 
-                       : std::string(1, PIECE_TO_CHAR[pieces[square]]);
+                       : std::string(1, PIECE_TO_CHAR[(int)pos().pieces[square]]);
                 str += " ";
             }
             str += "\n";
@@ -283,57 +413,99 @@ class Board
         std::cout << str;
     }
 
-    inline auto getPieces() { return pieces; }
+    inline auto getPieces() { return pos().pieces; }
 
-    inline Color sideToMove() { return colorToMove; }
+    inline Color sideToMove() { return pos().colorToMove; }
 
-    inline Color oppSide() { return oppColor(colorToMove); }
+    inline Color oppSide() { return oppColor(pos().colorToMove); }
 
-    inline Piece pieceAt(Square square) { return pieces[square]; }
+    inline Piece pieceAt(Square square) { return pos().pieces[square]; }
 
     inline PieceType pieceTypeAt(Square square) { 
-        return pieceToPieceType(pieces[square]); 
+        return pieceToPieceType(pos().pieces[square]); 
     }
 
     inline u64 occupancy() { 
-        return colorBitboard[(int)Color::WHITE] | colorBitboard[(int)Color::BLACK]; 
+        return pos().colorBitboard[(int)Color::WHITE] | pos().colorBitboard[(int)Color::BLACK]; 
     }
 
     inline u64 getBitboard(PieceType pieceType) {   
-        return piecesBitboards[(int)Color::WHITE][(int)pieceType] 
-               | piecesBitboards[(int)Color::BLACK][(int)pieceType];
+        return pos().piecesBitboards[(int)Color::WHITE][(int)pieceType] 
+               | pos().piecesBitboards[(int)Color::BLACK][(int)pieceType];
     }
 
-    inline u64 getBitboard(Color color) { return colorBitboard[(int)color]; }
+    inline u64 getBitboard(Color color) { return pos().colorBitboard[(int)color]; }
 
     inline u64 getBitboard(Color color, PieceType pieceType) {
-        return piecesBitboards[(int)color][(int)pieceType];
+        return pos().piecesBitboards[(int)color][(int)pieceType];
     }
 
-    inline u64 us() { return colorBitboard[(int)colorToMove]; }
+    inline u64 us() { return pos().colorBitboard[(int)pos().colorToMove]; }
 
-    inline u64 them() { return colorBitboard[(int)oppSide()]; }
+    inline u64 them() { return pos().colorBitboard[(int)oppSide()]; }
 
-    inline u64 getZobristHash() { return zobristHash; }
+    inline u64 getZobristHash() 
+    { 
+        static_assert(TRACK_HASH);
+        return pos().zobristHash; 
+    }
 
     inline bool isRepetition()
     {
-        if (states.size() < 4) return false;
+        static_assert(TRACK_HASH);
+        int numMoves = numMovesMade();
+        if (numMoves < 4) return false;
 
-        for (int i = (int)states.size() - 2; 
-        i >= 0 && i >= (int)states.size() - (int)pliesSincePawnMoveOrCapture - 1; 
+        for (int i = numMoves - 2; 
+        i >= 0 && i >= numMoves - (int)pos().pliesSincePawnMoveOrCapture - 1; 
         i -= 2)
-            if (states[i].zobristHash == zobristHash)
+            if (zobristHashAfter(i) == pos().zobristHash)
                 return true;
 
         return false;
     }
 
+    // Whether the side to move has a reversible move to a position that occured since the root, 'ply' plies ago or less
+    // The search can then score this node as at least a draw before the repetition is played
+    inline bool hasUpcomingRepetition(int ply)
+    {
+        static_assert(TRACK_HASH);
+
+        int numMoves = numMovesMade();
+        int end = std::min<int>(pos().pliesSincePawnMoveOrCapture, numMoves);
+        if (end < 3 || getNthToLastMove(1) == MOVE_NONE) return false;
+
+        u64 originalKey = pos().zobristHash;
+        u64 other = originalKey ^ zobristHashAfter(numMoves - 1) ^ ZOBRIST.colorToMove;
+
+        for (int i = 3; i <= end; i += 2)
+        {
+            // Positions before a null move can't be reached with moves
+            if (getNthToLastMove(i - 1) == MOVE_NONE || getNthToLastMove(i) == MOVE_NONE) 
+                return false;
+
+            // other is 0 when the moves since i plies ago are undone by a single move of ours
+            other ^= zobristHashAfter(numMoves - i + 1) ^ zobristHashAfter(numMoves - i) ^ ZOBRIST.colorToMove;
+            if (other != 0) continue;
+
+            u64 moveKey = originalKey ^ zobristHashAfter(numMoves - i);
+            int idx = CuckooTable::h1(moveKey);
+            if (CUCKOO.keys[idx] != moveKey) idx = CuckooTable::h2(moveKey);
+            if (CUCKOO.keys[idx] != moveKey) continue;
+
+            auto [sq1, sq2] = CUCKOO.squares[idx];
+            if ((attacks::between(sq1, sq2) & occupancy()) == 0 && ply > i)
+                return true;
+        }
+
+        return false;
+    }
+
     inline bool isDraw()
     {
         if (isRepetition()) return true;
 
-        if (pliesSincePawnMoveOrCapture >= 100) return true;
+        if (pos().pliesSincePawnMoveOrCapture >= 100) return true;
 
         // K vs K
         int numPieces = std::popcount(occupancy());
@@ -351,7 +523,7 @@ class Board
     inline bool isCapture(Move move) {
         assert(move != MOVE_NONE);
 
-        return pieceColor(pieces[move.to()]) == oppSide() 
+        return pieceColor(pos().pieces[move.to()]) == oppSide() 
                || move.typeFlag() == Move::EN_PASSANT_FLAG;
     }
 
@@ -372,16 +544,22 @@ class Board
         Square to = move.to();
         auto moveFlag = move.typeFlag();
 
+        // En passant is verified after making it, it can uncover a check along the rank of the captured pawn
+        if (verifyCheckLegality && moveFlag != Move::EN_PASSANT_FLAG && !isLegal(move))
+            return false;
+
+        if (USE_COPY_MAKE) positions.push_back(positions.back());
+
         Color oppositeColor = oppSide();
-        Piece pieceMoving = pieces[from];
-        Piece capturedPiece = pieces[to];
+        Piece pieceMoving = pos().pieces[from];
+        Piece capturedPiece = pos().pieces[to];
         Square capturedSquare = to;
 
         removePiece(from); // remove from source square
         removePiece(to);   // remove captured piece if any
 
         Piece pieceToPlace = move.promotion() == PieceType::NONE 
-                             ? pieceMoving : makePiece(move.promotion(), colorToMove);
+                             ? pieceMoving : makePiece(move.promotion(), pos().colorToMove);
                              
         placePiece(to, pieceToPlace); // place on target square
 
@@ -390,119 +568,131 @@ class Board
             // move rook
             auto [rookFrom, rookTo] = CASTLING_ROOK_FROM_TO[to];
             removePiece(rookFrom); 
-            placePiece(rookTo, makePiece(PieceType::ROOK, colorToMove));
+            placePiece(rookTo, makePiece(PieceType::ROOK, pos().colorToMove));
         }
         else if (moveFlag == Move::EN_PASSANT_FLAG)
         {
             // en passant, so remove captured pawn
-            capturedSquare = EN_PASSANT_CAPTURED_SQUARE[(int)colorToMove][(int)squareFile(to)];
+            capturedSquare = EN_PASSANT_CAPTURED_SQUARE[(int)pos().colorToMove][(int)squareFile(to)];
             capturedPiece = makePiece(PieceType::PAWN, oppositeColor);
             removePiece(capturedSquare);
         }
 
-        // Verify that this pseudolegal move is legal
+        // Verify that this en passant is legal
         // (side that played it is not in check after the move)
-        if (verifyCheckLegality && inCheckNoCache())
+        if (verifyCheckLegality && moveFlag == Move::EN_PASSANT_FLAG && inCheckNoCache())
         {
             // move is illegal
-            undoMove(move, capturedPiece);
+            if (USE_COPY_MAKE) 
+                positions.pop_back();
+            else
+                undoMove(move, capturedPiece);
             return false;
         }
 
         PieceType pieceType = pieceToPieceType(pieceMoving);
 
-        // append board state
-        BoardState state = BoardState(zobristHash, castlingRights, enPassantSquare, pliesSincePawnMoveOrCapture,
-                                      move, pieceType, capturedPiece, inCheckCached);
-        states.push_back(state);
+        if (USE_COPY_MAKE)
+        {
+            pos().move = move;
+            pos().pieceTypeMoved = pieceType;
+            pos().capturedPiece = capturedPiece;
+        }
+        else
+        {
+            // append board state
+            BoardState state = BoardState(pos().zobristHash, pos().castlingRights, pos().enPassantSquare, pos().pliesSincePawnMoveOrCapture,
+                                          move, pieceType, capturedPiece, pos().inCheckCached, pos().checkers, pos().pinned);
+            states.push_back(state);
+        }
 
-        // If not in perft, update zobrist hash and NNUE accumulator
-        if (!perft)
+        // Update the zobrist hash and NNUE accumulator, if this board tracks them
+        if constexpr (TRACK_HASH)
         {
-            nnue::push(); // save current accumulator
+            if constexpr (TRACK_NNUE) nnue::push(); // save current accumulator
 
             // update piece removed at source square
-            zobristHash ^= zobristPieces[(int)colorToMove][(int)pieceType][from];
-            nnue::currentAccumulator->update(colorToMove, pieceType, from, false);
+            pos().zobristHash ^= ZOBRIST.pieces[(int)pos().colorToMove][(int)pieceType][from];
+            if constexpr (TRACK_NNUE) nnue::update(pos().colorToMove, pieceType, from, false);
 
             // update piece placed at target square
             PieceType pieceTypeToPlace = pieceToPieceType(pieceToPlace);
-            zobristHash ^= zobristPieces[(int)colorToMove][(int)pieceTypeToPlace][to];
-            nnue::currentAccumulator->update(colorToMove, pieceTypeToPlace, to, true);
+            pos().zobristHash ^= ZOBRIST.pieces[(int)pos().colorToMove][(int)pieceTypeToPlace][to];
+            if constexpr (TRACK_NNUE) nnue::update(pos().colorToMove, pieceTypeToPlace, to, true);
 
             // if capture, update captured piece removal
             if (capturedPiece != Piece::NONE)
             {
                 PieceType pieceTypeCaptured = pieceToPieceType(capturedPiece);
-                zobristHash ^= zobristPieces[(int)oppositeColor][(int)pieceTypeCaptured][capturedSquare];
-                nnue::currentAccumulator->update(oppositeColor, pieceTypeCaptured, capturedSquare, false);
+                pos().zobristHash ^= ZOBRIST.pieces[(int)oppositeColor][(int)pieceTypeCaptured][capturedSquare];
+                if constexpr (TRACK_NNUE) nnue::update(oppositeColor, pieceTypeCaptured, capturedSquare, false);
             }
             // else if castling, update castling rook
             else if (moveFlag == Move::CASTLING_FLAG)
             {
                 auto [rookFrom, rookTo] = CASTLING_ROOK_FROM_TO[to];
                 // remove castling rook
-                zobristHash ^= zobristPieces[(int)colorToMove][(int)PieceType::ROOK][rookFrom];
-                nnue::currentAccumulator->update(colorToMove, PieceType::ROOK, rookFrom, false);
+                pos().zobristHash ^= ZOBRIST.pieces[(int)pos().colorToMove][(int)PieceType::ROOK][rookFrom];
+                if constexpr (TRACK_NNUE) nnue::update(pos().colorToMove, PieceType::ROOK, rookFrom, false);
                 // replace castling rook
-                zobristHash ^= zobristPieces[(int)colorToMove][(int)PieceType::ROOK][rookTo];
-                nnue::currentAccumulator->update(colorToMove, PieceType::ROOK, rookTo, true);
+                pos().zobristHash ^= ZOBRIST.pieces[(int)pos().colorToMove][(int)PieceType::ROOK][rookTo];
+                if constexpr (TRACK_NNUE) nnue::update(pos().colorToMove, PieceType::ROOK, rookTo, true);
             }
-        }
 
-        zobristHash ^= castlingRights; // XOR old castling rights out
+            pos().zobristHash ^= pos().castlingRights; // XOR old castling rights out
+        }
 
         if (pieceType == PieceType::KING)
         {
-            castlingRights &= ~CASTLING_MASKS[(int)colorToMove][CASTLE_SHORT]; 
-            castlingRights &= ~CASTLING_MASKS[(int)colorToMove][CASTLE_LONG]; 
+            pos().castlingRights &= ~CASTLING_MASKS[(int)pos().colorToMove][CASTLE_SHORT]; 
+            pos().castlingRights &= ~CASTLING_MASKS[(int)pos().colorToMove][CASTLE_LONG]; 
         }
-        else if ((1ULL << from) & castlingRights)
-            castlingRights &= ~(1ULL << from);
-        if ((1ULL << to) & castlingRights)
-            castlingRights &= ~(1ULL << to);
+        else if ((1ULL << from) & pos().castlingRights)
+            pos().castlingRights &= ~(1ULL << from);
+        if ((1ULL << to) & pos().castlingRights)
+            pos().castlingRights &= ~(1ULL << to);
 
-        zobristHash ^= castlingRights; // XOR new castling rights in
+        if constexpr (TRACK_HASH) pos().zobristHash ^= pos().castlingRights; // XOR new castling rights in
 
         if (pieceType == PieceType::PAWN || capturedPiece != Piece::NONE)
-            pliesSincePawnMoveOrCapture = 0;
+            pos().pliesSincePawnMoveOrCapture = 0;
         else
-            pliesSincePawnMoveOrCapture++;
+            pos().pliesSincePawnMoveOrCapture++;
 
         if (oppositeColor == Color::WHITE) 
-            currentMoveCounter++;
+            pos().currentMoveCounter++;
 
         // if en passant square active, XOR it out of zobrist hash, then reset en passant square
-        if (enPassantSquare != SQUARE_NONE)
+        if (pos().enPassantSquare != SQUARE_NONE)
         {
-            zobristHash ^= zobristEnPassantFiles[(int)squareFile(enPassantSquare)];
-            enPassantSquare = SQUARE_NONE;
+            if constexpr (TRACK_HASH) pos().zobristHash ^= ZOBRIST.enPassantFiles[(int)squareFile(pos().enPassantSquare)];
+            pos().enPassantSquare = SQUARE_NONE;
         }
 
         // Check if this move created an en passant square
         if (moveFlag == Move::PAWN_TWO_UP_FLAG)
         { 
             File file = squareFile(from);
-            Piece enemyPawn = colorToMove == Color::WHITE ? Piece::BLACK_PAWN : Piece::WHITE_PAWN;
+            Piece enemyPawn = pos().colorToMove == Color::WHITE ? Piece::BLACK_PAWN : Piece::WHITE_PAWN;
 
-            if ((file != File::A && pieces[to-1] == enemyPawn) || (file != File::H && pieces[to+1] == enemyPawn))
+            if ((file != File::A && pos().pieces[to-1] == enemyPawn) || (file != File::H && pos().pieces[to+1] == enemyPawn))
             {
-                enPassantSquare = colorToMove == Color::WHITE ? to - 8 : to + 8;
-                zobristHash ^= zobristEnPassantFiles[(int)file];
+                pos().enPassantSquare = pos().colorToMove == Color::WHITE ? to - 8 : to + 8;
+                if constexpr (TRACK_HASH) pos().zobristHash ^= ZOBRIST.enPassantFiles[(int)file];
             }
         }
 
-        colorToMove = oppositeColor;
-        zobristHash ^= zobristColorToMove;
+        pos().colorToMove = oppositeColor;
+        if constexpr (TRACK_HASH) pos().zobristHash ^= ZOBRIST.colorToMove;
 
-        inCheckCached = -1;
+        pos().inCheckCached = -1;
 
         return true; // move is legal
     }
 
     inline bool makeMove(std::string uci, bool verifyCheckLegality = true)
     {
-        return makeMove(Move::fromUci(uci, pieces), verifyCheckLegality);
+        return makeMove(Move::fromUci(uci, pos().pieces), verifyCheckLegality);
     }
 
     inline void undoMove(Move illegalMove = MOVE_NONE, Piece illegalyCapturedPiece = Piece::NONE)
@@ -512,14 +702,21 @@ class Board
 
         if (illegalMove == MOVE_NONE)
         {
+            if constexpr (TRACK_NNUE) nnue::pull(); // pull the previous accumulator
+
+            if (USE_COPY_MAKE)
+            {
+                positions.pop_back();
+                return;
+            }
+
             // undoing a legal move
             move = states.back().move;
-            colorToMove = oppSide();
+            pos().colorToMove = oppSide();
             capturedPiece = states.back().capturedPiece;
-            if (colorToMove == Color::BLACK) 
-                currentMoveCounter--;
+            if (pos().colorToMove == Color::BLACK) 
+                pos().currentMoveCounter--;
             pullState();
-            nnue::pull(); // pull the previous accumulator
         }
 
         Square from = move.from();
@@ -527,7 +724,7 @@ class Board
         auto moveFlag = move.typeFlag();
 
         Piece pieceMoved = move.promotion() == PieceType::NONE 
-                           ? pieces[to] : makePiece(PieceType::PAWN, colorToMove);
+                           ? pos().pieces[to] : makePiece(PieceType::PAWN, pos().colorToMove);
 
         removePiece(to); 
         placePiece(from, pieceMoved);
@@ -535,14 +732,14 @@ class Board
         if (capturedPiece != Piece::NONE)
         {
             Square capturedSquare = moveFlag == Move::EN_PASSANT_FLAG 
-                                    ? EN_PASSANT_CAPTURED_SQUARE[(int)colorToMove][(int)squareFile(to)] 
+                                    ? EN_PASSANT_CAPTURED_SQUARE[(int)pos().colorToMove][(int)squareFile(to)] 
                                     : to;
             placePiece(capturedSquare, capturedPiece);
         }
         else if (moveFlag == move.CASTLING_FLAG)
         {
             // replace rook
-            Piece rook = makePiece(PieceType::ROOK, colorToMove);
+            Piece rook = makePiece(PieceType::ROOK, pos().colorToMove);
             auto [rookFrom, rookTo] = CASTLING_ROOK_FROM_TO[to];
             removePiece(rookTo);
             placePiece(rookFrom, rook);
@@ -551,17 +748,19 @@ class Board
 
     private:
 
-    // Restore zobristHash, castlingRights, enPassantSquare, pliesSincePawnMoveOrCapture, inCheckCached
+    // Restore zobristHash, castlingRights, enPassantSquare, pliesSincePawnMoveOrCapture, inCheckCached, checkers, pinned
     inline void pullState()
     {
         assert(states.size() > 0);
         BoardState *state = &(states.back());
 
-        zobristHash = state->zobristHash;
-        castlingRights = state->castlingRights;
-        enPassantSquare = state->enPassantSquare;
-        pliesSincePawnMoveOrCapture = state->pliesSincePawnMoveOrCapture;
-        inCheckCached = state->inCheckCached;
+        pos().zobristHash = state->zobristHash;
+        pos().castlingRights = state->castlingRights;
+        pos().enPassantSquare = state->enPassantSquare;
+        pos().pliesSincePawnMoveOrCapture = state->pliesSincePawnMoveOrCapture;
+        pos().inCheckCached = state->inCheckCached;
+        pos().checkers = state->checkers;
+        pos().pinned = state->pinned;
 
         states.pop_back();
     }
@@ -571,40 +770,56 @@ class Board
     // Do not makeNullMove() in check!
     inline void makeNullMove()
     {
-        assert(!inCheckCached);
+        assert(!pos().inCheckCached);
         
-        // append board state
-        BoardState state = BoardState(zobristHash, castlingRights, enPassantSquare, pliesSincePawnMoveOrCapture, 
-                                      MOVE_NONE, PieceType::NONE, Piece::NONE, inCheckCached);
-        states.push_back(state);
+        if (USE_COPY_MAKE)
+        {
+            positions.push_back(positions.back());
+            pos().move = MOVE_NONE;
+            pos().pieceTypeMoved = PieceType::NONE;
+            pos().capturedPiece = Piece::NONE;
+        }
+        else
+        {
+            // append board state
+            BoardState state = BoardState(pos().zobristHash, pos().castlingRights, pos().enPassantSquare, pos().pliesSincePawnMoveOrCapture, 
+                                          MOVE_NONE, PieceType::NONE, Piece::NONE, pos().inCheckCached, pos().checkers, pos().pinned);
+            states.push_back(state);
+        }
 
-        colorToMove = oppSide();
-        zobristHash ^= zobristColorToMove;
+        pos().colorToMove = oppSide();
+        if constexpr (TRACK_HASH) pos().zobristHash ^= ZOBRIST.colorToMove;
 
-        pliesSincePawnMoveOrCapture++;
+        pos().pliesSincePawnMoveOrCapture++;
 
-        if (colorToMove == Color::WHITE)
-            currentMoveCounter++;
+        if (pos().colorToMove == Color::WHITE)
+            pos().currentMoveCounter++;
 
         // if en passant square active, XOR it out of zobrist, then reset en passant square
-        if (enPassantSquare != SQUARE_NONE)
+        if (pos().enPassantSquare != SQUARE_NONE)
         {
-            zobristHash ^= zobristEnPassantFiles[(int)squareFile(enPassantSquare)];
-            enPassantSquare = SQUARE_NONE;
+            if constexpr (TRACK_HASH) pos().zobristHash ^= ZOBRIST.enPassantFiles[(int)squareFile(pos().enPassantSquare)];
+            pos().enPassantSquare = SQUARE_NONE;
         }
 
-        inCheckCached = false;
+        pos().inCheckCached = -1; // not in check, but the pins of the side to move are unknown
     }
 
     inline void undoNullMove()
     {
+        if (USE_COPY_MAKE)
+        {
+            positions.pop_back();
+            return;
+        }
+
         pullState();
 
-        colorToMove = oppSide();
-        if (colorToMove == Color::BLACK)
-            currentMoveCounter--;
+        pos().colorToMove = oppSide();
+        if (pos().colorToMove == Color::BLACK)
+            pos().currentMoveCounter--;
 
-        assert(!inCheckCached);
+        assert(!pos().inCheckCached);
     }
 
     inline MovesList pseudolegalMoves(bool noisyOnly = false, bool underpromotions = true)
@@ -614,22 +829,22 @@ class Board
         u64 us = this->us(),
                  them = this->them(),
                  occupied = us | them,
-                 ourPawns = piecesBitboards[(int)colorToMove][(int)PieceType::PAWN],
-                 ourKnights = piecesBitboards[(int)colorToMove][(int)PieceType::KNIGHT],
-                 ourBishops = piecesBitboards[(int)colorToMove][(int)PieceType::BISHOP],
-                 ourRooks = piecesBitboards[(int)colorToMove][(int)PieceType::ROOK],
-                 ourQueens = piecesBitboards[(int)colorToMove][(int)PieceType::QUEEN],
-                 ourKing = piecesBitboards[(int)colorToMove][(int)PieceType::KING];
+                 ourPawns = pos().piecesBitboards[(int)pos().colorToMove][(int)PieceType::PAWN],
+                 ourKnights = pos().piecesBitboards[(int)pos().colorToMove][(int)PieceType::KNIGHT],
+                 ourBishops = pos().piecesBitboards[(int)pos().colorToMove][(int)PieceType::BISHOP],
+                 ourRooks = pos().piecesBitboards[(int)pos().colorToMove][(int)PieceType::ROOK],
+                 ourQueens = pos().piecesBitboards[(int)pos().colorToMove][(int)PieceType::QUEEN],
+                 ourKing = pos().piecesBitboards[(int)pos().colorToMove][(int)PieceType::KING];
 
         // En passant
-        if (enPassantSquare != SQUARE_NONE)
+        if (pos().enPassantSquare != SQUARE_NONE)
         {   
-            u64 ourEnPassantPawns = attacks::pawnAttacks(enPassantSquare, enemyColor) & ourPawns;
+            u64 ourEnPassantPawns = attacks::pawnAttacks(pos().enPassantSquare, enemyColor) & ourPawns;
             Piece ourPawn = makePiece(PieceType::PAWN, Color::WHITE);
             while (ourEnPassantPawns > 0)
             {
                 Square ourPawnSquare = poplsb(ourEnPassantPawns);
-                moves.add(Move(ourPawnSquare, enPassantSquare, Move::EN_PASSANT_FLAG));
+                moves.add(Move(ourPawnSquare, pos().enPassantSquare, Move::EN_PASSANT_FLAG), PieceType::PAWN, PieceType::PAWN);
             }
         }
 
@@ -640,28 +855,28 @@ class Board
             Rank rank = squareRank(sq);
             if (rank == Rank::RANK_2)
             {
-                pawnHasntMoved = colorToMove == Color::WHITE;
-                willPromote = colorToMove == Color::BLACK;
+                pawnHasntMoved = pos().colorToMove == Color::WHITE;
+                willPromote = pos().colorToMove == Color::BLACK;
             }
             else if (rank == Rank::RANK_7)
             {
-                pawnHasntMoved = colorToMove == Color::BLACK;
-                willPromote = colorToMove == Color::WHITE;
+                pawnHasntMoved = pos().colorToMove == Color::BLACK;
+                willPromote = pos().colorToMove == Color::WHITE;
             }
 
             // Generate this pawn's captures
-            u64 pawnAttacks = attacks::pawnAttacks(sq, colorToMove) & them;
+            u64 pawnAttacks = attacks::pawnAttacks(sq, pos().colorToMove) & them;
             while (pawnAttacks > 0)
             {
                 Square targetSquare = poplsb(pawnAttacks);
                 if (willPromote) 
                     addPromotions(moves, sq, targetSquare, underpromotions);
                 else 
-                    moves.add(Move(sq, targetSquare, Move::NORMAL_FLAG));
+                    moves.add(Move(sq, targetSquare, Move::NORMAL_FLAG), PieceType::PAWN, pieceTypeAt(targetSquare));
             }
 
-            Square squareOneUp = colorToMove == Color::WHITE ? sq + 8 : sq - 8;
-            if (pieces[squareOneUp] != Piece::NONE)
+            Square squareOneUp = pos().colorToMove == Color::WHITE ? sq + 8 : sq - 8;
+            if (pos().pieces[squareOneUp] != Piece::NONE)
                 continue;
 
             if (willPromote)
@@ -673,11 +888,11 @@ class Board
             if (noisyOnly) continue;
 
             // pawn 1 square up
-            moves.add(Move(sq, squareOneUp, Move::NORMAL_FLAG));
+            moves.add(Move(sq, squareOneUp, Move::NORMAL_FLAG), PieceType::PAWN);
             // pawn 2 squares up
-            Square squareTwoUp = colorToMove == Color::WHITE ? sq + 16 : sq - 16;
-            if (pawnHasntMoved && pieces[squareTwoUp] == Piece::NONE)
-                moves.add(Move(sq, squareTwoUp, Move::PAWN_TWO_UP_FLAG));
+            Square squareTwoUp = pos().colorToMove == Color::WHITE ? sq + 16 : sq - 16;
+            if (pawnHasntMoved && pos().pieces[squareTwoUp] == Piece::NONE)
+                moves.add(Move(sq, squareTwoUp, Move::PAWN_TWO_UP_FLAG), PieceType::PAWN);
         }
 
         while (ourKnights > 0)
@@ -687,7 +902,7 @@ class Board
             while (knightMoves > 0)
             {
                 Square targetSquare = poplsb(knightMoves);
-                moves.add(Move(sq, targetSquare, Move::NORMAL_FLAG));
+                moves.add(Move(sq, targetSquare, Move::NORMAL_FLAG), PieceType::KNIGHT, pieceTypeAt(targetSquare));
             }
         }
 
@@ -696,28 +911,25 @@ class Board
         while (kingMoves > 0)
         {
             Square targetSquare = poplsb(kingMoves);
-            moves.add(Move(kingSquare, targetSquare, Move::NORMAL_FLAG));
+            moves.add(Move(kingSquare, targetSquare, Move::NORMAL_FLAG), PieceType::KING, pieceTypeAt(targetSquare));
         }
 
         // Castling
         if (!noisyOnly)
         {
-            if ((castlingRights & CASTLING_MASKS[(int)colorToMove][CASTLE_SHORT]) > 0
-            && pieces[kingSquare+1] == Piece::NONE
-            && pieces[kingSquare+2] == Piece::NONE
+            if ((pos().castlingRights & CASTLING_MASKS[(int)pos().colorToMove][CASTLE_SHORT]) > 0
+            && (attacks::between(kingSquare, CASTLING_ROOK_FROM_TO[kingSquare+2].first) & occupied) == 0
             && !inCheck()
             && !isSquareAttacked(kingSquare+1, enemyColor) 
             && !isSquareAttacked(kingSquare+2, enemyColor))
-                moves.add(Move(kingSquare, kingSquare + 2, Move::CASTLING_FLAG));
+                moves.add(Move(kingSquare, kingSquare + 2, Move::CASTLING_FLAG), PieceType::KING);
 
-            if ((castlingRights & CASTLING_MASKS[(int)colorToMove][CASTLE_LONG]) > 0
-            && pieces[kingSquare-1] == Piece::NONE
-            && pieces[kingSquare-2] == Piece::NONE
-            && pieces[kingSquare-3] == Piece::NONE
+            if ((pos().castlingRights & CASTLING_MASKS[(int)pos().colorToMove][CASTLE_LONG]) > 0
+            && (attacks::between(kingSquare, CASTLING_ROOK_FROM_TO[kingSquare-2].first) & occupied) == 0
             && !inCheck()
             && !isSquareAttacked(kingSquare-1, enemyColor) 
             && !isSquareAttacked(kingSquare-2, enemyColor))
-                moves.add(Move(kingSquare, kingSquare - 2, Move::CASTLING_FLAG));
+                moves.add(Move(kingSquare, kingSquare - 2, Move::CASTLING_FLAG), PieceType::KING);
         }
         
         while (ourBishops > 0)
@@ -728,7 +940,7 @@ class Board
             while (bishopMoves > 0)
             {
                 Square targetSquare = poplsb(bishopMoves);
-                moves.add(Move(sq, targetSquare, Move::NORMAL_FLAG));
+                moves.add(Move(sq, targetSquare, Move::NORMAL_FLAG), PieceType::BISHOP, pieceTypeAt(targetSquare));
             }
         }
 
@@ -740,7 +952,7 @@ class Board
             while (rookMoves > 0)
             {
                 Square targetSquare = poplsb(rookMoves);
-                moves.add(Move(sq, targetSquare, Move::NORMAL_FLAG));
+                moves.add(Move(sq, targetSquare, Move::NORMAL_FLAG), PieceType::ROOK, pieceTypeAt(targetSquare));
             }
         }
 
@@ -752,7 +964,7 @@ class Board
             while (queenMoves > 0)
             {
                 Square targetSquare = poplsb(queenMoves);
-                moves.add(Move(sq, targetSquare, Move::NORMAL_FLAG));
+                moves.add(Move(sq, targetSquare, Move::NORMAL_FLAG), PieceType::QUEEN, pieceTypeAt(targetSquare));
             }
         }
 
@@ -763,12 +975,13 @@ class Board
 
     inline void addPromotions(MovesList &moves, Square sq, Square targetSquare, bool underpromotions)
     {
-        moves.add(Move(sq, targetSquare, Move::QUEEN_PROMOTION_FLAG));
+        PieceType captured = pieceTypeAt(targetSquare);
+        moves.add(Move(sq, targetSquare, Move::QUEEN_PROMOTION_FLAG), PieceType::PAWN, captured);
         if (underpromotions)
         {
-            moves.add(Move(sq, targetSquare, Move::ROOK_PROMOTION_FLAG));
-            moves.add(Move(sq, targetSquare, Move::BISHOP_PROMOTION_FLAG));
-            moves.add(Move(sq, targetSquare, Move::KNIGHT_PROMOTION_FLAG));
+            moves.add(Move(sq, targetSquare, Move::ROOK_PROMOTION_FLAG), PieceType::PAWN, captured);
+            moves.add(Move(sq, targetSquare, Move::BISHOP_PROMOTION_FLAG), PieceType::PAWN, captured);
+            moves.add(Move(sq, targetSquare, Move::KNIGHT_PROMOTION_FLAG), PieceType::PAWN, captured);
         }
     }
 
@@ -779,19 +992,19 @@ class Board
          // Idea: put a super piece in this square and see if its attacks intersect with an enemy piece
 
         u64 pawnAttacks = attacks::pawnAttacks(square, oppColor(colorAttacking));
-        if ((pawnAttacks & piecesBitboards[(int)colorAttacking][(int)PieceType::PAWN]) > 0)
+        if ((pawnAttacks & pos().piecesBitboards[(int)colorAttacking][(int)PieceType::PAWN]) > 0)
             return true;
 
         u64 knightAttacks = attacks::knightAttacks(square);
-        if ((knightAttacks & piecesBitboards[(int)colorAttacking][(int)PieceType::KNIGHT]) > 0) 
+        if ((knightAttacks & pos().piecesBitboards[(int)colorAttacking][(int)PieceType::KNIGHT]) > 0) 
             return true;
 
         u64 occupied = occupancy();
 
         // Get the slider pieces of the attacker
-        u64 attackerBishops = piecesBitboards[(int)colorAttacking][(int)PieceType::BISHOP],
-            attackerRooks   = piecesBitboards[(int)colorAttacking][(int)PieceType::ROOK],
-            attackerQueens  = piecesBitboards[(int)colorAttacking][(int)PieceType::QUEEN];
+        u64 attackerBishops = pos().piecesBitboards[(int)colorAttacking][(int)PieceType::BISHOP],
+            attackerRooks   = pos().piecesBitboards[(int)colorAttacking][(int)PieceType::ROOK],
+            attackerQueens  = pos().piecesBitboards[(int)colorAttacking][(int)PieceType::QUEEN];
 
         u64 bishopAttacks = attacks::bishopAttacks(square, occupied);
         if ((bishopAttacks & (attackerBishops | attackerQueens)) > 0)
@@ -802,27 +1015,85 @@ class Board
             return true;
 
         u64 kingAttacks = attacks::kingAttacks(square);
-        if ((kingAttacks & piecesBitboards[(int)colorAttacking][(int)PieceType::KING]) > 0) 
+        if ((kingAttacks & pos().piecesBitboards[(int)colorAttacking][(int)PieceType::KING]) > 0) 
             return true;
 
         return false;
     }   
 
+    // Pieces of colorAttacking attacking square, with the given occupancy for the sliders
+    inline u64 attackers(Square square, Color colorAttacking, u64 occupied)
+    {
+        u64 bishopsQueens = pos().piecesBitboards[(int)colorAttacking][(int)PieceType::BISHOP] 
+                            | pos().piecesBitboards[(int)colorAttacking][(int)PieceType::QUEEN];
+        u64 rooksQueens = pos().piecesBitboards[(int)colorAttacking][(int)PieceType::ROOK] 
+                          | pos().piecesBitboards[(int)colorAttacking][(int)PieceType::QUEEN];
+
+        return (attacks::pawnAttacks(square, oppColor(colorAttacking)) & pos().piecesBitboards[(int)colorAttacking][(int)PieceType::PAWN])
+               | (attacks::knightAttacks(square) & pos().piecesBitboards[(int)colorAttacking][(int)PieceType::KNIGHT])
+               | (attacks::kingAttacks(square) & pos().piecesBitboards[(int)colorAttacking][(int)PieceType::KING])
+               | (attacks::bishopAttacks(square, occupied) & bishopsQueens)
+               | (attacks::rookAttacks(square, occupied) & rooksQueens);
+    }
+
     inline bool inCheck()
     {
-        if (inCheckCached != -1) return inCheckCached;
+        if (pos().inCheckCached == -1) updateCheckersAndPinned();
+        return pos().inCheckCached;
+    }
 
-        u64 ourKingBitboard = piecesBitboards[(int)colorToMove][(int)PieceType::KING];
-        Square ourKingSquare = lsb(ourKingBitboard);
-        return inCheckCached = isSquareAttacked(ourKingSquare, oppSide());
+    // Legality of a pseudolegal move, without making it
+    // Castling is fully verified in pseudolegalMoves(), en passant must be verified by making it
+    inline bool isLegal(Move move)
+    {
+        assert(move.typeFlag() != Move::EN_PASSANT_FLAG);
+
+        if (move.typeFlag() == Move::CASTLING_FLAG) return true;
+        if (pos().inCheckCached == -1) updateCheckersAndPinned();
+
+        Square from = move.from(), to = move.to();
+        Square kingSquare = lsb(pos().piecesBitboards[(int)pos().colorToMove][(int)PieceType::KING]);
+
+        // King can't move to an attacked square, including squares behind it on a checking slider's line
+        if (from == kingSquare)
+            return attackers(to, oppSide(), occupancy() ^ (1ULL << from)) == 0;
+
+        // In double check, only the king can move
+        // In check, block the checker or capture it
+        if (pos().checkers > 0 
+        && (std::popcount(pos().checkers) > 1 || ((attacks::between(kingSquare, lsb(pos().checkers)) | pos().checkers) & (1ULL << to)) == 0))
+            return false;
+
+        // A pinned piece can only move along the pin line
+        return (pos().pinned & (1ULL << from)) == 0 || (attacks::line(kingSquare, from) & (1ULL << to)) > 0;
     }
 
     private:
 
+    inline void updateCheckersAndPinned()
+    {
+        Square kingSquare = lsb(pos().piecesBitboards[(int)pos().colorToMove][(int)PieceType::KING]);
+        Color enemyColor = oppSide();
+        u64 occupied = occupancy();
+
+        pos().checkers = attackers(kingSquare, enemyColor, occupied);
+        pos().inCheckCached = pos().checkers > 0;
+
+        // Enemy sliders x-raying our king through exactly one of our pieces pin it
+        u64 pinners = (attacks::xrayBishopAttacks(kingSquare, occupied, us()) 
+                       & (pos().piecesBitboards[(int)enemyColor][(int)PieceType::BISHOP] | pos().piecesBitboards[(int)enemyColor][(int)PieceType::QUEEN]))
+                      | (attacks::xrayRookAttacks(kingSquare, occupied, us()) 
+                       & (pos().piecesBitboards[(int)enemyColor][(int)PieceType::ROOK] | pos().piecesBitboards[(int)enemyColor][(int)PieceType::QUEEN]));
+
+        pos().pinned = 0;
+        while (pinners > 0)
+            pos().pinned |= attacks::between(kingSquare, poplsb(pinners)) & us();
+    }
+
     // Used internally in makeMove()
     inline bool inCheckNoCache()
     {
-        u64 ourKingBitboard = piecesBitboards[(int)colorToMove][(int)PieceType::KING];
+        u64 ourKingBitboard = pos().piecesBitboards[(int)pos().colorToMove][(int)PieceType::KING];
         Square ourKingSquare = lsb(ourKingBitboard);
         return isSquareAttacked(ourKingSquare, oppSide());
     }
@@ -837,30 +1108,75 @@ class Board
                    || getBitboard(PieceType::ROOK) > 0
                    || getBitboard(PieceType::QUEEN) > 0;
 
-        return piecesBitboards[(int)color][(int)PieceType::KNIGHT] > 0
-               || piecesBitboards[(int)color][(int)PieceType::BISHOP] > 0
-               || piecesBitboards[(int)color][(int)PieceType::ROOK] > 0
-               || piecesBitboards[(int)color][(int)PieceType::QUEEN] > 0;
+        return pos().piecesBitboards[(int)color][(int)PieceType::KNIGHT] > 0
+               || pos().piecesBitboards[(int)color][(int)PieceType::BISHOP] > 0
+               || pos().piecesBitboards[(int)color][(int)PieceType::ROOK] > 0
+               || pos().piecesBitboards[(int)color][(int)PieceType::QUEEN] > 0;
     }
 
     inline Move getLastMove() 
     { 
-        return states.size() > 0 ? states.back().move : MOVE_NONE; 
+        return getNthToLastMove(1);
     }
 
     inline Move getNthToLastMove(u16 n)
     {
         assert(n >= 1); 
-        return states.size() >= n 
-               ? states[states.size() - n].move : MOVE_NONE;
+        if (numMovesMade() < n) return MOVE_NONE;
+
+        return USE_COPY_MAKE ? positions[positions.size() - n].move 
+                         : states[states.size() - n].move;
     }
 
     inline PieceType getNthToLastMovePieceType(u16 n)
     {
         assert(n >= 1); 
-        return states.size() >= n 
-               ? states[states.size() - n].pieceTypeMoved : PieceType::NONE;
+        if (numMovesMade() < n) return PieceType::NONE;
+
+        return USE_COPY_MAKE ? positions[positions.size() - n].pieceTypeMoved
+                         : states[states.size() - n].pieceTypeMoved;
     }
-    
+
+    // The stacks hold MAX_GAME_PLIES moves plus a search, so games longer than that call this after every move
+    // Once MAX_GAME_PLIES moves were made, only the moves since the last pawn move or capture are kept
+    // (all repetition detection needs, capped at the 100 plies of the 50 moves rule), the board is set
+    // to the position before them and they are made again
+    inline void trimHistory()
+    {
+        if (numMovesMade() < MAX_GAME_PLIES) return;
+
+        int numKept = std::min<int>({ pos().pliesSincePawnMoveOrCapture, numMovesMade(), 100 });
+        Move keptMoves[100];
+
+        for (int i = numKept - 1; i >= 0; i--)
+        {
+            keptMoves[i] = getLastMove();
+            undoMove();
+        }
+
+        char fenBuffer[MAX_FEN_LENGTH];
+        setFen(std::string_view(fenBuffer, writeFen(fenBuffer)));
+
+        for (int i = 0; i < numKept; i++)
+            makeMove(keptMoves[i], false);
+    }
+
 };
 
+using Board = BasicBoard<Tracking::HASH_AND_NNUE>;
+
+namespace attacks {
+
+// All squares attacked by color's pieces
+inline u64 allAttacks(Board &board, Color color)
+{
+    return allAttacks(color,
+                      board.getBitboard(color, PieceType::PAWN),
+                      board.getBitboard(color, PieceType::KNIGHT),
+                      board.getBitboard(color, PieceType::BISHOP) | board.getBitboard(color, PieceType::QUEEN),
+                      board.getBitboard(color, PieceType::ROOK) | board.getBitboard(color, PieceType::QUEEN),
+                      board.getBitboard(color, PieceType::KING),
+                      board.occupancy());
+}
+
+}
@@ -46,6 +46,7 @@ int main(int argc, char* argv[])
     std::cout << "Generating data to " << filePath << std::endl;
 
     attacks::init();
+    nnue::init();
     nnue::loadNetFromFile();
     search::init();
     uci::outputSearchInfo = false;
@@ -68,18 +69,19 @@ int main(int argc, char* argv[])
     {
         runNewGame:
 
-        board = Board(START_FEN);
+        // Random opening on a board that tracks nothing, the search board is built from its fen
+        BasicBoard<Tracking::NONE> openingBoard = BasicBoard<Tracking::NONE>(START_FEN);
         int numRandomPlies = distribution(gen);
 
         for (int i = 0; i < numRandomPlies; i++)
         {
             std::cout << "opening" << std::endl;
-            MovesList moves = board.pseudolegalMoves();
+            MovesList moves = openingBoard.pseudolegalMoves();
             moves.shuffle();
 
             int j = 0;
             for (j = 0; j < moves.size(); j++)
-                if (board.makeMove(moves[j])) break;
+                if (openingBoard.makeMove(moves[j])) break;
 
             // if no legal move, its stalemate or checkmate, so generate another random opening
             if (j == moves.size()) 
@@ -89,6 +91,7 @@ int main(int argc, char* argv[])
             }
         }
 
+        board = Board(openingBoard.fen());
         uci::ucinewgame();
 
         std::cout << "d10 search" << std::endl;
@@ -133,6 +136,7 @@ int main(int argc, char* argv[])
             }
 
             board.makeMove(bestMove);
+            board.trimHistory();
 
             if (board.isDraw())
             {
@@ -0,0 +1,84 @@
+#pragma once
+
+// clang-format off
+
+#include <cmath>
+#include <limits>
+#include "nnue.hpp"
+
+namespace nnue {
+
+// Float net as trained, and as saved in the trainer's .bin checkpoints:
+// all parameters in one float array, in NN order, with QA = QB = 1
+template <typename A>
+struct FloatNet
+{
+    static constexpr u64 FEATURE_WEIGHTS = 0,
+                         FEATURE_BIASES  = FEATURE_WEIGHTS + A::FEATURES * A::HIDDEN_SIZE,
+                         OUTPUT_WEIGHTS  = FEATURE_BIASES + A::HIDDEN_SIZE,
+                         OUTPUT_BIAS     = OUTPUT_WEIGHTS + A::OUTPUT_BUCKETS * A::HIDDEN_SIZE * 2,
+                         NUM_PARAMS      = OUTPUT_BIAS + A::OUTPUT_BUCKETS;
+
+    std::vector<float> params = std::vector<float>(NUM_PARAMS, 0);
+
+    inline bool load(std::string filePath)
+    {
+        std::ifstream file(filePath, std::ios::binary | std::ios::ate);
+
+        if (!file.is_open() || (u64)file.tellg() != NUM_PARAMS * sizeof(float))
+        {
+            std::cout << "Error loading checkpoint " << filePath << ": expected "
+                      << NUM_PARAMS * sizeof(float) << " bytes" << std::endl;
+            return false;
+        }
+
+        file.seekg(0);
+        file.read((char*)params.data(), NUM_PARAMS * sizeof(float));
+        return true;
+    }
+
+    inline bool save(std::string filePath)
+    {
+        std::ofstream file(filePath, std::ios::binary);
+        if (!file.is_open())
+        {
+            std::cout << "Error creating " << filePath << std::endl;
+            return false;
+        }
+
+        file.write((const char*)params.data(), NUM_PARAMS * sizeof(float));
+        return true;
+    }
+
+    // Quantizes to the engine's scheme: feature weights and biases x QA, output weights x QB
+    // and output biases x QA x QB, rounded to nearest and clamped to the integer types
+    // Returns the number of parameters that had to be clamped
+    inline u64 quantize(NN<A> &nn)
+    {
+        constexpr i32 I16_MIN = std::numeric_limits<i16>::min(),
+                      I16_MAX = std::numeric_limits<i16>::max();
+        u64 numClamped = 0;
+
+        auto round = [&](float value, float scale, i32 min, i32 max) {
+            long rounded = lround(value * scale);
+            numClamped += rounded < min || rounded > max;
+            return std::clamp<long>(rounded, min, max);
+        };
+
+        for (u64 i = 0; i < A::FEATURES * A::HIDDEN_SIZE; i++)
+            nn.featureWeights[i] = round(params[FEATURE_WEIGHTS + i], A::QA, I16_MIN, I16_MAX);
+
+        for (u64 i = 0; i < A::HIDDEN_SIZE; i++)
+            nn.featureBiases[i] = round(params[FEATURE_BIASES + i], A::QA, I16_MIN, I16_MAX);
+
+        for (u64 i = 0; i < A::OUTPUT_BUCKETS * A::HIDDEN_SIZE * 2; i++)
+            nn.outputWeights[i] = round(params[OUTPUT_WEIGHTS + i], A::QB, -127, 127);
+
+        for (u64 i = 0; i < A::OUTPUT_BUCKETS; i++)
+            nn.outputBias[i] = round(params[OUTPUT_BIAS + i], A::QA * A::QB, I16_MIN, I16_MAX);
+
+        return numClamped;
+    }
+};
+
+}
@@ -0,0 +1,83 @@
+#pragma once
+
+// clang-format off
+
+namespace search {
+
+// History scores by [pieceType][targetSquare], i16 since every history stays within +-historyMax
+using PieceToHistory = std::array<std::array<i16, 64>, 6>;
+
+PieceToHistory mainHistory[2];  // [color]
+PieceToHistory noisyHistory[2]; // [color]
+
+// Continuation histories, [color][lastMovePieceType][lastMoveTargetSquare] -> [pieceType][targetSquare]
+// A node looks up its 2 sub-tables once, so scoring its quiets reads 2 contiguous 768 byte tables
+PieceToHistory countermoveHistory[2][6][64];  // by last move
+PieceToHistory followupMoveHistory[2][6][64]; // by 2nd-to-last move
+
+Move countermoves[2][6][64]; // [color][lastMovePieceType][lastMoveTargetSquare]
+
+inline void clearHistories()
+{
+    memset(mainHistory, 0, sizeof(mainHistory));
+    memset(noisyHistory, 0, sizeof(noisyHistory));
+    memset(countermoveHistory, 0, sizeof(countermoveHistory));
+    memset(followupMoveHistory, 0, sizeof(followupMoveHistory));
+    memset(countermoves, 0, sizeof(countermoves));
+}
+
+inline void updateHistory(i16 &history, i32 bonus)
+{
+    history += bonus - history * abs(bonus) / historyMax.value;
+}
+
+// The history tables of the side to move in a node
+// The continuation sub-tables and the countermove slot come from the search stack entries of the last 2 moves,
+// they are nullptr if there is no last/2nd-to-last move (or it's a null move)
+struct NodeHistories
+{
+    PieceToHistory *main, *noisy, *countermoveHistory, *followupMoveHistory;
+    Move *countermove;
+
+    inline NodeHistories(Color stm, PieceToHistory *countermoveHistory, PieceToHistory *followupMoveHistory, Move *countermove)
+    : main(&search::mainHistory[(int)stm]), noisy(&search::noisyHistory[(int)stm]), 
+      countermoveHistory(countermoveHistory), followupMoveHistory(followupMoveHistory), countermove(countermove) { }
+
+    inline Move getCountermove() {
+        return countermove == nullptr ? MOVE_NONE : *countermove;
+    }
+
+    inline i32 quietHistory(int pieceType, int targetSq)
+    {
+        i32 quietHist = (*main)[pieceType][targetSq];
+
+        if (countermoveHistory != nullptr)
+            quietHist += (*countermoveHistory)[pieceType][targetSq];
+
+        if (followupMoveHistory != nullptr)
+            quietHist += (*followupMoveHistory)[pieceType][targetSq];
+
+        return quietHist;
+    }
+
+    inline void updateQuietHistory(int pieceType, int targetSq, i32 bonus)
+    {
+        updateHistory((*main)[pieceType][targetSq], bonus);
+
+        if (countermoveHistory != nullptr)
+            updateHistory((*countermoveHistory)[pieceType][targetSq], bonus);
+
+        if (followupMoveHistory != nullptr)
+            updateHistory((*followupMoveHistory)[pieceType][targetSq], bonus);
+    }
+
+    inline i16 &noisyHistory(int pieceType, int targetSq) {
+        return (*noisy)[pieceType][targetSq];
+    }
+
+    inline void updateNoisyHistory(int pieceType, int targetSq, i32 bonus) {
+        updateHistory((*noisy)[pieceType][targetSq], bonus);
+    }
+};
+
+}
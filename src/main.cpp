@@ -10,9 +10,10 @@ Board board;
 int main()
 {
     std::cout << "Starzix by zzzzz" << std::endl;
-    attacks::init();
-    search::init();
-    board = Board(START_FEN);
+    bench::timeStartupStep("attacks", attacks::init);
+    bench::timeStartupStep("nnue", nnue::init);
+    bench::timeStartupStep("search", search::init);
+    bench::timeStartupStep("board", []() { board = Board(START_FEN); });
     uci::uciLoop();
     return 0;
 }
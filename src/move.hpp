@@ -118,19 +118,24 @@ struct Move
 
 Move MOVE_NONE = Move();
 
+// Moves stay 16 bits (TT, killers, countermoves, UCI), the list also keeps the type of the piece moving 
+// and of the piece captured by each move, so scoring and history indexing don't go back to the board
 struct MovesList
 {
     private:
 
     Move moves[256];
+    u8 pieceTypes[256]; // moving piece type in the low 4 bits, captured piece type in the high 4 bits
     u8 numMoves = 0;
 
     public:
 
     inline MovesList() = default;
 
-    inline void add(Move move) { 
+    inline void add(Move move, PieceType pieceType, PieceType captured = PieceType::NONE) { 
         assert(numMoves < 255);
+        assert(pieceType != PieceType::NONE);
+        pieceTypes[numMoves] = (u8)pieceType | ((u8)captured << 4);
         moves[numMoves++] = move; 
     }
 
@@ -141,12 +146,22 @@ struct MovesList
         return moves[i];
     }
 
+    inline PieceType pieceType(int i) {
+        assert(i >= 0 && i < numMoves);
+        return (PieceType)(pieceTypes[i] & 0xF);
+    }
+
+    // PieceType::PAWN for en passant, PieceType::NONE if not a capture
+    inline PieceType captured(int i) {
+        assert(i >= 0 && i < numMoves);
+        return (PieceType)(pieceTypes[i] >> 4);
+    }
+
     inline void swap(int i, int j)
     {
     	assert(i >= 0 && j >= 0 && i < numMoves && j < numMoves);
-        Move temp = moves[i];
-        moves[i] = moves[j];
-        moves[j] = temp;
+        std::swap(moves[i], moves[j]);
+        std::swap(pieceTypes[i], pieceTypes[j]);
     }
 
     inline void shuffle()
@@ -0,0 +1,100 @@
+#pragma once
+
+// clang-format off
+
+#include "board.hpp"
+#include "nnue.hpp"
+
+namespace nnue {
+
+bool pruneNetOnLoad = false; // UCI option PruneNet
+
+// Dead neuron pruning
+// A hidden neuron is dead if its crelu output is 0 for both perspectives in every sampled position
+// or if both its output weights are 0, so it never changes the eval.
+// Live neurons are moved to the front and only those are updated and evaluated.
+// The samples are the given positions and all their children, so an unseen position can still
+// activate a 'dead' neuron. Every 8th position (and its children) is held out of the sampling and
+// the eval drift on those is reported to check it's negligible (on the samples it's 0 by construction).
+inline void pruneDeadNeurons(std::vector<std::string> fens)
+{
+    const size_t HOLD_OUT_EVERY = 8;
+    std::vector<std::string> sampleFens, heldOutFens;
+
+    for (size_t i = 0; i < fens.size(); i++)
+        (i % HOLD_OUT_EVERY == HOLD_OUT_EVERY - 1 ? heldOutFens : sampleFens).push_back(fens[i]);
+
+    const u16 HIDDEN_SIZE = MainArch::HIDDEN_SIZE;
+    mainNet.pack(); // start from the full net
+    const NN<MainArch> *nn = mainNet.raw();
+
+    std::array<bool, HIDDEN_SIZE> active = {};
+    std::vector<i32> heldOutEvals;
+
+    // Visits the given positions and their children, calling callback(board) on each
+    auto forEachPosition = [&](std::vector<std::string> &positions, auto &&callback) {
+        for (std::string fen : positions)
+        {
+            Board board = Board(fen);
+            callback(board);
+
+            MovesList moves = board.pseudolegalMoves();
+            for (int i = 0; i < moves.size(); i++)
+            {
+                if (!board.makeMove(moves[i])) continue;
+                callback(board);
+                board.undoMove();
+            }
+        }
+    };
+
+    // The board isn't read: making/undoing its moves updates mainNet's current accumulator, which is sampled
+    forEachPosition(sampleFens, [&](Board &/* board */) {
+        for (int i = 0; i < HIDDEN_SIZE; i++)
+            active[i] |= mainNet.currentAccumulator->white[i] > 0 || mainNet.currentAccumulator->black[i] > 0;
+    });
+
+    forEachPosition(heldOutFens, [&](Board &board) {
+        heldOutEvals.push_back(evaluate(board.sideToMove(), std::popcount(board.occupancy())));
+    });
+
+    // Live neurons first, dead ones last
+    std::array<u16, HIDDEN_SIZE> neurons;
+    u16 numLive = 0;
+
+    for (int i = 0; i < HIDDEN_SIZE; i++)
+        if (active[i] && (nn->outputWeights[i] != 0 || nn->outputWeights[HIDDEN_SIZE + i] != 0))
+            neurons[numLive++] = i;
+
+    for (int i = 0, numDead = 0; i < HIDDEN_SIZE; i++)
+        if (!active[i] || (nn->outputWeights[i] == 0 && nn->outputWeights[HIDDEN_SIZE + i] == 0))
+            neurons[numLive + numDead++] = i;
+
+    mainNet.permuteNeurons(neurons, numLive);
+
+    // Eval drift: evaluate the held out positions again with the pruned net
+    u64 heldOutIdx = 0;
+    i32 maxDrift = 0;
+    u64 totalDrift = 0, numDrifted = 0;
+
+    forEachPosition(heldOutFens, [&](Board &board) {
+        i32 drift = abs(evaluate(board.sideToMove(), std::popcount(board.occupancy())) - heldOutEvals[heldOutIdx++]);
+        maxDrift = std::max(maxDrift, drift);
+        totalDrift += drift;
+        numDrifted += drift != 0;
+    });
+
+    std::cout << "Pruned net: " << numLive << "/" << HIDDEN_SIZE << " live neurons"
+              << ", width " << mainNet.packed.width;
+
+    if (heldOutEvals.empty())
+        std::cout << ", eval drift not measured (needs " << HOLD_OUT_EVERY << "+ positions to hold some out)";
+    else
+        std::cout << ", eval drift on " << heldOutEvals.size() << " held out positions: "
+                  << "mean " << (double)totalDrift / heldOutEvals.size() << " cp, max " << maxDrift << " cp"
+                  << ", changed " << numDrifted;
+
+    std::cout << std::endl;
+}
+
+}
@@ -0,0 +1,240 @@
+// clang-format off
+
+#include <iostream>
+#include <cstdlib>
+#include <cmath>
+#include "board.hpp"
+
+Board board;
+
+#include "search.hpp"
+#include "uci.hpp"
+#include "float_net.hpp"
+
+// Net inspection and conversion for nnue::MainArch nets
+// Nets are .nnue files (with or without header) or <internal> for the embedded net
+//
+// nettool stats <net>
+//     Weight and bias statistics, dead neurons
+// nettool quantize <checkpoint.bin> <out.nnue>
+//     Quantizes a trainer float checkpoint to the engine's scheme (QA = 255, QB = 64, output bias x QA x QB)
+// nettool diff <net A> <net B> [positions file]
+//     Evaluates both nets on the positions (bench positions by default) and compares the evals
+// nettool pack <net> <out.nnue> [positions file]
+//     Prunes dead neurons on the positions (bench positions by default) and writes the net in that order
+//     with a header, so loading it uses the pruned width without sampling or permuting again
+
+using A = nnue::MainArch;
+
+inline bool loadNet(nnue::Network<A> &net, std::string filePath)
+{
+    if (filePath == nnue::EMBEDDED_NET_NAME)
+    {
+        net.useEmbedded(nnue::gNetFileData);
+        return true;
+    }
+
+    return net.loadFromFile(filePath);
+}
+
+inline std::vector<std::string> positionsOrBench(int argc, char* argv[], int argIdx)
+{
+    return argIdx < argc
+           ? readFens(argv[argIdx])
+           : std::vector<std::string>(bench::FENS.begin(), bench::FENS.end());
+}
+
+template <typename T>
+inline void printStats(std::string name, const T *values, u64 size)
+{
+    double sum = 0, sumSquares = 0;
+    i32 min = values[0], max = values[0];
+    u64 zeros = 0;
+
+    for (u64 i = 0; i < size; i++)
+    {
+        sum += values[i];
+        sumSquares += (double)values[i] * values[i];
+        min = std::min<i32>(min, values[i]);
+        max = std::max<i32>(max, values[i]);
+        zeros += values[i] == 0;
+    }
+
+    double mean = sum / size;
+    std::cout << name << ": " << size << " values"
+              << ", min " << min << ", max " << max
+              << ", mean " << mean << ", stddev " << sqrt(std::max(sumSquares / size - mean * mean, 0.0))
+              << ", zeros " << zeros
+              << std::endl;
+}
+
+inline int stats(std::string filePath)
+{
+    nnue::Network<A> net;
+    if (!loadNet(net, filePath)) return 1;
+
+    net.printInfo(filePath);
+    const nnue::NN<A> *nn = net.raw();
+
+    printStats("Feature weights", nn->featureWeights.data(), nn->featureWeights.size());
+    printStats("Feature biases", nn->featureBiases.data(), nn->featureBiases.size());
+    printStats("Output weights", nn->outputWeights.data(), nn->outputWeights.size());
+    printStats("Output bias", nn->outputBias.data(), nn->outputBias.size());
+
+    // Neurons that can't change the eval in any position
+    int zeroOutput = 0, neverActive = 0;
+
+    for (int i = 0; i < A::HIDDEN_SIZE; i++)
+    {
+        bool allOutputWeightsZero = true;
+        for (int bucket = 0; bucket < A::OUTPUT_BUCKETS; bucket++)
+            allOutputWeightsZero &= nn->outputWeights[bucket * A::HIDDEN_SIZE * 2 + i] == 0
+                                    && nn->outputWeights[bucket * A::HIDDEN_SIZE * 2 + A::HIDDEN_SIZE + i] == 0;
+
+        // Upper bound of the accumulator: bias + the 32 largest weights of this neuron
+        std::vector<i16> weights(A::FEATURES);
+        for (int feature = 0; feature < A::FEATURES; feature++)
+            weights[feature] = nn->featureWeights[feature * A::HIDDEN_SIZE + i];
+
+        std::partial_sort(weights.begin(), weights.begin() + 32, weights.end(), std::greater<i16>());
+        i32 maxAccumulator = nn->featureBiases[i];
+        for (int k = 0; k < 32; k++)
+            maxAccumulator += std::max<i16>(weights[k], 0);
+
+        zeroOutput += allOutputWeightsZero;
+        neverActive += maxAccumulator <= 0;
+    }
+
+    std::cout << "Hidden neurons: " << A::HIDDEN_SIZE
+              << ", all output weights zero " << zeroOutput
+              << ", can never activate " << neverActive
+              << std::endl;
+
+    return 0;
+}
+
+inline int quantize(std::string checkpointPath, std::string outputPath)
+{
+    nnue::FloatNet<A> floatNet;
+    if (!floatNet.load(checkpointPath)) return 1;
+
+    std::unique_ptr<nnue::NN<A>> nn = std::make_unique<nnue::NN<A>>();
+    u64 numClamped = floatNet.quantize(*nn);
+
+    std::ofstream file(outputPath, std::ios::binary);
+    if (!file.is_open())
+    {
+        std::cout << "Error creating " << outputPath << std::endl;
+        return 1;
+    }
+
+    file.write((const char*)nn.get(), nnue::NET_SIZE<A>);
+
+    std::cout << "Quantized " << checkpointPath << " to " << outputPath
+              << " (QA " << A::QA << ", QB " << A::QB << ")"
+              << ", " << numClamped << " parameters clamped"
+              << ", hash 0x" << std::hex << nnue::internal::hash(nn.get(), nnue::NET_SIZE<A>) << std::dec
+              << std::endl;
+
+    return 0;
+}
+
+inline int diff(std::string filePathA, std::string filePathB, std::vector<std::string> fens)
+{
+    nnue::Network<A> netA, netB;
+    if (!loadNet(netA, filePathA) || !loadNet(netB, filePathB)) return 1;
+
+    netA.printInfo(filePathA);
+    netB.printInfo(filePathB);
+
+    std::vector<nnue::CompactPosition> positions;
+    std::vector<std::string> validFens;
+
+    for (std::string &fen : fens)
+    {
+        nnue::CompactPosition pos;
+        if (!nnue::toCompactPosition(fen, pos)) continue;
+        positions.push_back(pos);
+        validFens.push_back(fen);
+    }
+
+    if (positions.size() == 0)
+    {
+        std::cout << "No positions" << std::endl;
+        return 1;
+    }
+
+    std::vector<i32> evalsA(positions.size()), evalsB(positions.size());
+    netA.evaluateBatch(positions.data(), evalsA.data(), positions.size());
+    netB.evaluateBatch(positions.data(), evalsB.data(), positions.size());
+
+    double totalDiff = 0, totalSquaredDiff = 0;
+    u64 maxDiffIdx = 0, sameSign = 0, identical = 0;
+
+    for (u64 i = 0; i < positions.size(); i++)
+    {
+        i32 diff = abs(evalsA[i] - evalsB[i]);
+        totalDiff += diff;
+        totalSquaredDiff += (double)diff * diff;
+        sameSign += (evalsA[i] > 0) == (evalsB[i] > 0);
+        identical += diff == 0;
+
+        if (diff > abs(evalsA[maxDiffIdx] - evalsB[maxDiffIdx]))
+            maxDiffIdx = i;
+    }
+
+    std::cout << positions.size() << " positions"
+              << ", identical " << identical
+              << ", mean diff " << totalDiff / positions.size() << " cp"
+              << ", rms diff " << sqrt(totalSquaredDiff / positions.size()) << " cp"
+              << ", same sign " << 100.0 * sameSign / positions.size() << "%"
+              << std::endl;
+
+    std::cout << "Max diff " << abs(evalsA[maxDiffIdx] - evalsB[maxDiffIdx]) << " cp"
+              << " (" << evalsA[maxDiffIdx] << " vs " << evalsB[maxDiffIdx] << ")"
+              << " at " << validFens[maxDiffIdx]
+              << std::endl;
+
+    return 0;
+}
+
+inline int pack(std::string filePath, std::string outputPath, std::vector<std::string> fens)
+{
+    if (filePath != nnue::EMBEDDED_NET_NAME && !nnue::loadNetFromFile(filePath))
+        return 1;
+
+    nnue::pruneDeadNeurons(fens);
+
+    if (!nnue::mainNet.writeToFile(outputPath)) return 1;
+
+    std::cout << "Wrote " << outputPath << std::endl;
+    return 0;
+}
+
+int main(int argc, char* argv[])
+{
+    attacks::init();
+    nnue::init();
+
+    std::string command = argc > 1 ? argv[1] : "";
+
+    if (command == "stats" && argc > 2)
+        return stats(argv[2]);
+
+    if (command == "quantize" && argc > 3)
+        return quantize(argv[2], argv[3]);
+
+    if (command == "diff" && argc > 3)
+        return diff(argv[2], argv[3], positionsOrBench(argc, argv, 4));
+
+    if (command == "pack" && argc > 3)
+        return pack(argv[2], argv[3], positionsOrBench(argc, argv, 4));
+
+    std::cout << "Usage:" << std::endl
+              << "nettool stats <net>" << std::endl
+              << "nettool quantize <checkpoint.bin> <out.nnue>" << std::endl
+              << "nettool diff <net A> <net B> [positions file]" << std::endl
+              << "nettool pack <net> <out.nnue> [positions file]" << std::endl;
+
+    return 1;
+}
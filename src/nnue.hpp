@@ -1,5 +1,22 @@
 #pragma once
 
+#include <cstddef> // for offsetof()
+#include <memory>
+#include <thread>
+#include <utility>
+
+#if defined(_WIN32)
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
 #ifdef _MSC_VER
 #define STARZIX_MSVC
 #pragma push_macro("_MSC_VER")
@@ -11,103 +28,712 @@
 
 namespace nnue {
 
-const u16 HIDDEN_LAYER_SIZE = 384;
-const i32 SCALE = 400, 
-          Q = 255 * 64, 
-          NORMALIZATION_K = 1;
+enum class Activation : u8 {
+    CRELU = 0,  // clamp(x, 0, QA)
+    SCRELU = 1  // clamp(x, 0, QA)^2
+};
+
+// Net architecture, fixed at compile time
+// (FEATURES -> HIDDEN_SIZE)x2 -> OUTPUT_BUCKETS, output bucket chosen by number of pieces
+// Quantization: feature weights/biases by QA, output weights by QB
+template <u16 _FEATURES, u16 _HIDDEN_SIZE, u8 _OUTPUT_BUCKETS, Activation _ACTIVATION,
+          i32 _SCALE = 400, i32 _QA = 255, i32 _QB = 64>
+struct Arch {
+    static constexpr u16 FEATURES = _FEATURES;
+    static constexpr u16 HIDDEN_SIZE = _HIDDEN_SIZE;
+    static constexpr u8 OUTPUT_BUCKETS = _OUTPUT_BUCKETS;
+    static constexpr Activation ACTIVATION = _ACTIVATION;
+    static constexpr i32 SCALE = _SCALE, QA = _QA, QB = _QB;
+
+    static_assert(FEATURES == 768, "Only the 768 (color, piece type, square) feature set is implemented");
+    static_assert(HIDDEN_SIZE % 32 == 0, "Kernels work on 32 neurons (64 bytes) at a time");
+    static_assert(OUTPUT_BUCKETS >= 1 && OUTPUT_BUCKETS <= 32);
+};
+
+using MainArch = Arch<768, 384, 1, Activation::CRELU>;
+
+// Optional tiny net for evals that don't need to be precise (see search::evaluate(alpha, beta))
+using SmallArch = Arch<768, 32, 1, Activation::CRELU>;
+
+const i32 NORMALIZATION_K = 1;
 
+// Net as stored on disk, after the optional header
+template <typename A>
 struct alignas(64) NN {
-    std::array<i16, 768 * HIDDEN_LAYER_SIZE> featureWeights;
-    std::array<i16, HIDDEN_LAYER_SIZE> featureBiases;
-    std::array<i8, HIDDEN_LAYER_SIZE * 2> outputWeights;
-    i16 outputBias;
+    std::array<i16, A::FEATURES * A::HIDDEN_SIZE> featureWeights;
+    std::array<i16, A::HIDDEN_SIZE> featureBiases;
+    std::array<i8, A::OUTPUT_BUCKETS * A::HIDDEN_SIZE * 2> outputWeights; // [bucket][us, them][neuron]
+    std::array<i16, A::OUTPUT_BUCKETS> outputBias;
+};
+
+// sizeof(NN) includes the alignas(64) padding at the end, which isn't stored in .nnue files
+template <typename A>
+constexpr u64 NET_SIZE = offsetof(NN<A>, outputBias) + sizeof(NN<A>::outputBias);
+
+// Optional header before the weights in .nnue files, so a net of another architecture is refused
+// 64 bytes so the weights stay 64-byte aligned when the file is mapped
+struct alignas(64) NetHeader {
+    std::array<char, 4> magic = {'S', 'Z', 'N', 'N'};
+    u16 features = 0, hiddenSize = 0;
+    u8 outputBuckets = 0;
+    Activation activation = Activation::CRELU;
+    i16 scale = 0, qa = 0, qb = 0;
+
+    // Not part of the architecture: if nonzero, the net was packed ahead of time (nettool pack)
+    // with its dead hidden neurons last, and only the first liveNeurons are used
+    u16 liveNeurons = 0;
+
+    inline bool operator==(const NetHeader &other) const {
+        return magic == other.magic && features == other.features && hiddenSize == other.hiddenSize
+               && outputBuckets == other.outputBuckets && activation == other.activation
+               && scale == other.scale && qa == other.qa && qb == other.qb;
+    }
 };
 
+static_assert(sizeof(NetHeader) == 64);
+
+template <typename A>
+constexpr NetHeader netHeader() {
+    NetHeader header;
+    header.features = A::FEATURES;
+    header.hiddenSize = A::HIDDEN_SIZE;
+    header.outputBuckets = A::OUTPUT_BUCKETS;
+    header.activation = A::ACTIVATION;
+    header.scale = A::SCALE;
+    header.qa = A::QA;
+    header.qb = A::QB;
+    return header;
+}
+
+const std::string EMBEDDED_NET_NAME = "<internal>";
+const std::string NO_NET_NAME = "<empty>";
+
 INCBIN(NetFile, "src/net.nnue");
-const NN *nn = reinterpret_cast<const NN*>(gNetFileData);
 
-struct Accumulator
+namespace internal {
+
+// FNV-1a, only used to identify nets, e.g. when A/B testing them
+inline u64 hash(const void *data, u64 size)
+{
+    const u8 *bytes = reinterpret_cast<const u8*>(data);
+    u64 hash = 14695981039346656037ULL;
+
+    for (u64 i = 0; i < size; i++)
+    {
+        hash ^= bytes[i];
+        hash *= 1099511628211ULL;
+    }
+
+    return hash;
+}
+
+// Memory maps a file read-only, returning nullptr on failure
+// The pages are shared with every other process that maps the same file
+inline void* mapFile(std::string &filePath, u64 &fileSize)
+{
+    void *data = nullptr;
+
+    #if defined(_WIN32)
+        HANDLE file = CreateFileA(filePath.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr,
+                                  OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+        if (file == INVALID_HANDLE_VALUE) return nullptr;
+
+        LARGE_INTEGER size;
+        GetFileSizeEx(file, &size);
+        fileSize = size.QuadPart;
+
+        HANDLE mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+        if (mapping != nullptr)
+        {
+            data = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+            CloseHandle(mapping); // the view keeps the mapping alive
+        }
+        CloseHandle(file);
+    #else
+        int fd = open(filePath.c_str(), O_RDONLY);
+        if (fd == -1) return nullptr;
+
+        struct stat fileStat;
+        fstat(fd, &fileStat);
+        fileSize = fileStat.st_size;
+
+        if (fileSize > 0)
+        {
+            data = mmap(nullptr, fileSize, PROT_READ, MAP_SHARED, fd, 0);
+            if (data == MAP_FAILED) data = nullptr;
+        }
+        close(fd); // the mapping stays valid after closing the file
+    #endif
+
+    return data;
+}
+
+inline void unmapFile(void *data, u64 fileSize)
 {
-    i16 white[HIDDEN_LAYER_SIZE];
-    i16 black[HIDDEN_LAYER_SIZE];
+    #if defined(_WIN32)
+        UnmapViewOfFile(data);
+    #else
+        munmap(data, fileSize);
+    #endif
+}
+
+template <typename A>
+inline i16 activation(i16 x) {
+    return std::clamp<i16>(x, 0, A::QA);
+}
+
+// Kernels are instantiated per architecture and width so the compiler fully vectorizes them
 
-    inline Accumulator()
+template <typename A, u16 WIDTH>
+inline void updateAccumulator(i16 *white, i16 *black, const i16 *whiteWeights, const i16 *blackWeights, bool activate)
+{
+    for (int i = 0; i < WIDTH; i++)
     {
-        for (int i = 0; i < HIDDEN_LAYER_SIZE; i++)
-            white[i] = black[i] = nn->featureBiases[i];
+        if (activate)
+        {
+            white[i] += whiteWeights[i];
+            black[i] += blackWeights[i];
+        }
+        else
+        {
+            white[i] -= whiteWeights[i];
+            black[i] -= blackWeights[i];
+        }
     }
+}
 
-    inline void update(Color color, PieceType pieceType, Square sq, bool activate)
+// One loop per perspective, so each is a plain i16 * i16 dot product the compiler vectorizes
+// For SCReLU, v * w fits in i16 (QA * max |i8|), then it's multiplied by v again
+template <typename A, u16 WIDTH>
+inline i32 outputDotProduct(const i16 *us, const i16 *them, const i16 *outputWeights)
+{
+    i32 sum = 0;
+
+    for (int i = 0; i < WIDTH; i++)
+    {
+        i16 v = activation<A>(us[i]);
+        if constexpr (A::ACTIVATION == Activation::SCRELU)
+            sum += (i16)(v * outputWeights[i]) * v;
+        else
+            sum += v * outputWeights[i];
+    }
+
+    for (int i = 0; i < WIDTH; i++)
+    {
+        i16 v = activation<A>(them[i]);
+        if constexpr (A::ACTIVATION == Activation::SCRELU)
+            sum += (i16)(v * outputWeights[A::HIDDEN_SIZE + i]) * v;
+        else
+            sum += v * outputWeights[A::HIDDEN_SIZE + i];
+    }
+
+    return sum;
+}
+
+using UpdateKernel = void (*)(i16*, i16*, const i16*, const i16*, bool);
+using OutputKernel = i32 (*)(const i16*, const i16*, const i16*);
+
+// [width / 32 - 1], for pruned nets
+template <typename A, u16... I>
+constexpr std::array<UpdateKernel, sizeof...(I)> makeUpdateKernels(std::integer_sequence<u16, I...>) {
+    return { &updateAccumulator<A, (I + 1) * 32>... };
+}
+template <typename A, u16... I>
+constexpr std::array<OutputKernel, sizeof...(I)> makeOutputKernels(std::integer_sequence<u16, I...>) {
+    return { &outputDotProduct<A, (I + 1) * 32>... };
+}
+
+}
+
+// Compact position for batch evaluation (25 bytes)
+struct CompactPosition {
+    u64 occupancy;
+    std::array<u8, 16> pieces; // piece of each occupied square in square order, 4 bits each, low nibble first
+    Color sideToMove;
+
+    inline Piece pieceAt(int i) const {
+        return (Piece)((pieces[i / 2] >> (i % 2 * 4)) & 0b1111);
+    }
+
+    inline void setPiece(int i, Piece piece) {
+        pieces[i / 2] |= (u8)piece << (i % 2 * 4);
+    }
+
+    // Feature indexes from the side to move's (us) and the opponent's (them) perspectives
+    // Returns the number of pieces
+    inline int features(u16 *us, u16 *them) const
+    {
+        u64 occ = occupancy;
+        int numPieces = 0;
+
+        while (occ > 0)
+        {
+            Square sq = poplsb(occ);
+            Piece piece = pieceAt(numPieces);
+            int color = (int)pieceColor(piece), pieceType = (int)pieceToPieceType(piece);
+            u16 whiteIdx = color * 384 + pieceType * 64 + sq;
+            u16 blackIdx = !color * 384 + pieceType * 64 + (sq ^ 56);
+
+            us[numPieces] = sideToMove == Color::WHITE ? whiteIdx : blackIdx;
+            them[numPieces] = sideToMove == Color::WHITE ? blackIdx : whiteIdx;
+            numPieces++;
+        }
+
+        return numPieces;
+    }
+} __attribute__((packed));
+
+// The net in the layout the inference loops want, built from the raw net whenever the net changes
+// The on-disk format stays the same
+template <typename A>
+struct alignas(64) PackedNN {
+    // Rows are already contiguous per feature, so these point into the raw net (no copy)
+    const i16 *featureWeights; // [A::FEATURES * A::HIDDEN_SIZE]
+
+    std::array<i16, A::HIDDEN_SIZE> featureBiases;
+
+    // Widened from i8 so activation(x) * weight is an i16 * i16 multiply-add (pmaddwd)
+    // instead of sign extending every weight in the loop
+    alignas(64) std::array<i16, A::OUTPUT_BUCKETS * A::HIDDEN_SIZE * 2> outputWeights;
+
+    std::array<i32, A::OUTPUT_BUCKETS> outputBias;
+
+    // Only the first 'width' hidden neurons are updated and evaluated (see permuteNeurons())
+    // If width < A::HIDDEN_SIZE, the kernels for that width are called through these pointers
+    u16 width = A::HIDDEN_SIZE;
+    internal::UpdateKernel updateKernel = internal::updateAccumulator<A, A::HIDDEN_SIZE>;
+    internal::OutputKernel outputKernel = internal::outputDotProduct<A, A::HIDDEN_SIZE>;
+};
+
+template <typename A>
+struct alignas(64) Accumulator
+{
+    i16 white[A::HIDDEN_SIZE];
+    i16 black[A::HIDDEN_SIZE];
+
+    inline Accumulator() = default;
+
+    inline Accumulator(const PackedNN<A> &packed)
+    {
+        for (int i = 0; i < A::HIDDEN_SIZE; i++)
+            white[i] = black[i] = packed.featureBiases[i];
+    }
+
+    inline void update(const PackedNN<A> &packed, Color color, PieceType pieceType, Square sq, bool activate)
     {
         int whiteIdx = (int)color * 384 + (int)pieceType * 64 + sq;
         int blackIdx = !(int)color * 384 + (int)pieceType * 64 + (sq ^ 56);
-        int whiteOffset = whiteIdx * HIDDEN_LAYER_SIZE;
-        int blackOffset = blackIdx * HIDDEN_LAYER_SIZE;
+        const i16 *whiteWeights = &packed.featureWeights[whiteIdx * A::HIDDEN_SIZE];
+        const i16 *blackWeights = &packed.featureWeights[blackIdx * A::HIDDEN_SIZE];
 
-        for (int i = 0; i < HIDDEN_LAYER_SIZE; i++)
-        {
-            if (activate)
+        // Full width kernel is inlined, pruned nets go through the pointer
+        if (packed.width == A::HIDDEN_SIZE)
+            internal::updateAccumulator<A, A::HIDDEN_SIZE>(white, black, whiteWeights, blackWeights, activate);
+        else
+            packed.updateKernel(white, black, whiteWeights, blackWeights, activate);
+    }
+};
+
+// A net of architecture A, either embedded in the binary or memory mapped from a file,
+// plus its packed copy and the accumulator stack
+template <typename A>
+class Network
+{
+    private:
+
+    const NN<A> *nn = nullptr;
+
+    // File mapped with loadFromFile(), nullptr if using an embedded net
+    void *mappedFile = nullptr;
+    u64 mappedFileSize = 0;
+
+    // Copy of the net with reordered hidden neurons, nullptr if packed points into *nn
+    std::unique_ptr<NN<A>> permutedNet = nullptr;
+
+    FixedStack<Accumulator<A>> accumulators;
+
+    constexpr static auto UPDATE_KERNELS
+        = internal::makeUpdateKernels<A>(std::make_integer_sequence<u16, A::HIDDEN_SIZE / 32>());
+    constexpr static auto OUTPUT_KERNELS
+        = internal::makeOutputKernels<A>(std::make_integer_sequence<u16, A::HIDDEN_SIZE / 32>());
+
+    public:
+
+    PackedNN<A> packed;
+    Accumulator<A> *currentAccumulator = nullptr;
+
+    inline Network() = default;
+
+    inline Network(const void *embeddedData) { useEmbedded(embeddedData); }
+
+    inline const NN<A>* raw() { return nn; }
+
+    inline bool isLoaded() { return nn != nullptr; }
+
+    inline void pack()
+    {
+        packed.featureWeights = nn->featureWeights.data();
+        packed.width = A::HIDDEN_SIZE;
+        packed.updateKernel = internal::updateAccumulator<A, A::HIDDEN_SIZE>;
+        packed.outputKernel = internal::outputDotProduct<A, A::HIDDEN_SIZE>;
+        permutedNet = nullptr;
+
+        for (int i = 0; i < A::HIDDEN_SIZE; i++)
+            packed.featureBiases[i] = nn->featureBiases[i];
+
+        for (int i = 0; i < A::OUTPUT_BUCKETS * A::HIDDEN_SIZE * 2; i++)
+            packed.outputWeights[i] = nn->outputWeights[i];
+
+        for (int i = 0; i < A::OUTPUT_BUCKETS; i++)
+            packed.outputBias[i] = nn->outputBias[i];
+    }
+
+    // Reorder the hidden neurons of *nn so that new neuron i is old neuron neurons[i], and only use the first 'width' ones
+    // Needs a copy of the feature weights, so the packed net no longer points into *nn
+    inline void permuteNeurons(std::array<u16, A::HIDDEN_SIZE> &neurons, u16 width)
+    {
+        pack();
+        permutedNet = std::make_unique<NN<A>>();
+
+        for (int feature = 0; feature < A::FEATURES; feature++)
+            for (int i = 0; i < A::HIDDEN_SIZE; i++)
+                permutedNet->featureWeights[feature * A::HIDDEN_SIZE + i]
+                    = nn->featureWeights[feature * A::HIDDEN_SIZE + neurons[i]];
+
+        for (int i = 0; i < A::HIDDEN_SIZE; i++)
+            packed.featureBiases[i] = nn->featureBiases[neurons[i]];
+
+        for (int bucket = 0; bucket < A::OUTPUT_BUCKETS; bucket++)
+            for (int i = 0; i < A::HIDDEN_SIZE * 2; i++)
             {
-                white[i] += nn->featureWeights[whiteOffset + i];
-                black[i] += nn->featureWeights[blackOffset + i];
+                int offset = bucket * A::HIDDEN_SIZE * 2 + (i >= A::HIDDEN_SIZE ? A::HIDDEN_SIZE : 0);
+                packed.outputWeights[bucket * A::HIDDEN_SIZE * 2 + i]
+                    = nn->outputWeights[offset + neurons[i % A::HIDDEN_SIZE]];
             }
-            else
+
+        packed.featureWeights = permutedNet->featureWeights.data();
+        setWidth(width);
+    }
+
+    // Only update and evaluate the first 'width' hidden neurons, rounded up to a kernel width
+    inline void setWidth(u16 width)
+    {
+        width = std::clamp<u16>((width + 31) / 32 * 32, 32, A::HIDDEN_SIZE);
+        packed.width = width;
+        packed.updateKernel = UPDATE_KERNELS[width / 32 - 1];
+        packed.outputKernel = OUTPUT_KERNELS[width / 32 - 1];
+    }
+
+    inline void useEmbedded(const void *data)
+    {
+        nn = reinterpret_cast<const NN<A>*>(data);
+        unmap();
+        pack();
+    }
+
+    // Memory map a .nnue file (no copy) and use it as the net
+    // The file is the net with or without a NetHeader before it, and is refused if it's
+    // another architecture (header mismatch or wrong size)
+    // If the file is invalid, the current net is kept and false is returned
+    // Accumulators aren't refreshed, so the caller must rebuild the board after a successful load
+    inline bool loadFromFile(std::string filePath)
+    {
+        u64 fileSize = 0;
+        void *data = internal::mapFile(filePath, fileSize);
+        u64 headerSize = fileSize == sizeof(NetHeader) + NET_SIZE<A> ? sizeof(NetHeader) : 0;
+
+        std::string error = "";
+        if (data == nullptr)
+            error = "failed to open/map file";
+        else if (fileSize != NET_SIZE<A> && fileSize != sizeof(NetHeader) + NET_SIZE<A>)
+            error = "expected " + std::to_string(NET_SIZE<A>) + " bytes (+" + std::to_string(sizeof(NetHeader))
+                    + " with header), got " + std::to_string(fileSize);
+        else if (headerSize > 0 && !(*reinterpret_cast<const NetHeader*>(data) == netHeader<A>()))
+            error = "header doesn't match this build's net architecture";
+        else if ((uintptr_t)data % alignof(NN<A>) != 0)
+            error = "file isn't mapped at a " + std::to_string(alignof(NN<A>)) + "-byte aligned address";
+
+        if (error != "")
+        {
+            std::cout << "Error loading net " << filePath << ": " << error << std::endl;
+            if (data != nullptr) internal::unmapFile(data, fileSize);
+            return false;
+        }
+
+        // Swap the net, then unmap the previous one (never called during a search)
+        unmap();
+        mappedFile = data;
+        mappedFileSize = fileSize;
+        nn = reinterpret_cast<const NN<A>*>((u8*)data + headerSize);
+        pack();
+
+        u16 liveNeurons = headerSize > 0 ? reinterpret_cast<const NetHeader*>(data)->liveNeurons : 0;
+        if (liveNeurons > 0) setWidth(liveNeurons);
+
+        return true;
+    }
+
+    // Writes the net as it's currently used (neuron order and width) with a header,
+    // so loading it doesn't need to prune or permute again
+    inline bool writeToFile(std::string filePath)
+    {
+        std::unique_ptr<NN<A>> out = std::make_unique<NN<A>>();
+
+        for (int i = 0; i < A::FEATURES * A::HIDDEN_SIZE; i++)
+            out->featureWeights[i] = packed.featureWeights[i];
+
+        for (int i = 0; i < A::HIDDEN_SIZE; i++)
+            out->featureBiases[i] = packed.featureBiases[i];
+
+        for (int i = 0; i < A::OUTPUT_BUCKETS * A::HIDDEN_SIZE * 2; i++)
+            out->outputWeights[i] = packed.outputWeights[i];
+
+        for (int i = 0; i < A::OUTPUT_BUCKETS; i++)
+            out->outputBias[i] = packed.outputBias[i];
+
+        NetHeader header = netHeader<A>();
+        header.liveNeurons = packed.width < A::HIDDEN_SIZE ? packed.width : 0;
+
+        std::ofstream file(filePath, std::ios::binary);
+        if (!file.is_open())
+        {
+            std::cout << "Error creating " << filePath << std::endl;
+            return false;
+        }
+
+        file.write((const char*)&header, sizeof(NetHeader));
+        file.write((const char*)out.get(), NET_SIZE<A>);
+        return true;
+    }
+
+    inline void unmap()
+    {
+        if (mappedFile == nullptr) return;
+        internal::unmapFile(mappedFile, mappedFileSize);
+        mappedFile = nullptr;
+    }
+
+    inline void unload()
+    {
+        unmap();
+        nn = nullptr;
+        permutedNet = nullptr;
+        accumulators.clear();
+        currentAccumulator = nullptr;
+    }
+
+    inline void printInfo(std::string netName)
+    {
+        std::cout << "Net: " << netName
+                  << " (" << A::FEATURES << "->" << A::HIDDEN_SIZE << "x2->" << (int)A::OUTPUT_BUCKETS
+                  << (A::ACTIVATION == Activation::SCRELU ? " screlu" : " crelu")
+                  << (packed.width < A::HIDDEN_SIZE ? ", width " + std::to_string(packed.width) : "")
+                  << ", hash 0x" << std::hex << internal::hash(nn, NET_SIZE<A>) << std::dec << ")"
+                  << std::endl;
+    }
+
+    inline void reset()
+    {
+        if (!accumulators.allocated()) 
+            accumulators = FixedStack<Accumulator<A>>(STACK_CAPACITY);
+
+        accumulators.clear();
+        accumulators.push_back(Accumulator<A>(packed));
+        currentAccumulator = &accumulators.back();
+    }
+
+    inline void push()
+    {
+        assert(currentAccumulator == &accumulators.back());
+        accumulators.push_back(*currentAccumulator);
+        currentAccumulator = &accumulators.back();
+    }
+
+    inline void pull()
+    {
+        assert(accumulators.size() > 1);
+        accumulators.pop_back();
+        currentAccumulator = &accumulators.back();
+    }
+
+    inline void update(Color color, PieceType pieceType, Square sq, bool activate) {
+        currentAccumulator->update(packed, color, pieceType, sq, activate);
+    }
+
+    // Output bucket by number of pieces, from 2 to 32
+    inline static int outputBucket(u8 numPieces)
+    {
+        constexpr int DIVISOR = (32 + A::OUTPUT_BUCKETS - 1) / A::OUTPUT_BUCKETS;
+        return A::OUTPUT_BUCKETS == 1 ? 0 : std::min((numPieces - 2) / DIVISOR, A::OUTPUT_BUCKETS - 1);
+    }
+
+    // Output layer sum to centipawns
+    inline i32 scaleOutput(i32 sum, int bucket)
+    {
+        // SCReLU sums are scaled by QA twice
+        if constexpr (A::ACTIVATION == Activation::SCRELU)
+            sum /= A::QA;
+
+        return (sum / NORMALIZATION_K + packed.outputBias[bucket]) * A::SCALE / (A::QA * A::QB);
+    }
+
+    inline i32 evaluate(const Accumulator<A> &accumulator, Color color, u8 numPieces)
+    {
+        const i16 *us = accumulator.white,
+                  *them = accumulator.black;
+
+        if (color == Color::BLACK)
+        {
+            us = accumulator.black;
+            them = accumulator.white;
+        }
+
+        int bucket = outputBucket(numPieces);
+        const i16 *outputWeights = &packed.outputWeights[bucket * A::HIDDEN_SIZE * 2];
+
+        i32 sum = packed.width == A::HIDDEN_SIZE
+                  ? internal::outputDotProduct<A, A::HIDDEN_SIZE>(us, them, outputWeights)
+                  : packed.outputKernel(us, them, outputWeights);
+
+        return scaleOutput(sum, bucket);
+    }
+
+    inline i32 evaluate(Color color, u8 numPieces) {
+        return evaluate(*currentAccumulator, color, numPieces);
+    }
+
+    // Evaluates many positions from scratch, from each one's side to move perspective, without Board or accumulator stack
+    // Positions are split between threads. Each thread goes through its positions in chunks and,
+    // for each block of 32 hidden neurons, sums that block of every position in the chunk,
+    // so only 768 x 64 bytes of feature weights are hot at a time instead of the whole net
+    inline void evaluateBatch(const CompactPosition *positions, i32 *evals, u64 numPositions, int numThreads = 1)
+    {
+        constexpr int CHUNK_SIZE = 256, BLOCK_SIZE = 32;
+
+        auto evaluateRange = [&](u64 start, u64 end)
+        {
+            // Feature indexes of each position in the chunk, [position][0 for us, 1 for them][piece]
+            std::vector<std::array<std::array<u16, 32>, 2>> features(CHUNK_SIZE);
+            std::array<u8, CHUNK_SIZE> numPieces;
+            std::array<i32, CHUNK_SIZE> sums;
+
+            for (u64 chunkStart = start; chunkStart < end; chunkStart += CHUNK_SIZE)
             {
-                white[i] -= nn->featureWeights[whiteOffset + i];
-                black[i] -= nn->featureWeights[blackOffset + i];
+                int chunkSize = std::min<u64>(CHUNK_SIZE, end - chunkStart);
+
+                for (int p = 0; p < chunkSize; p++)
+                {
+                    numPieces[p] = positions[chunkStart + p].features(features[p][0].data(), features[p][1].data());
+                    sums[p] = 0;
+                }
+
+                for (int block = 0; block < packed.width; block += BLOCK_SIZE)
+                    for (int p = 0; p < chunkSize; p++)
+                    {
+                        alignas(64) i16 us[BLOCK_SIZE], them[BLOCK_SIZE];
+
+                        for (int i = 0; i < BLOCK_SIZE; i++)
+                            us[i] = them[i] = packed.featureBiases[block + i];
+
+                        for (int k = 0; k < numPieces[p]; k++)
+                        {
+                            const i16 *usWeights = &packed.featureWeights[features[p][0][k] * A::HIDDEN_SIZE + block];
+                            const i16 *themWeights = &packed.featureWeights[features[p][1][k] * A::HIDDEN_SIZE + block];
+                            internal::updateAccumulator<A, BLOCK_SIZE>(us, them, usWeights, themWeights, true);
+                        }
+
+                        int bucket = outputBucket(numPieces[p]);
+                        const i16 *outputWeights = &packed.outputWeights[bucket * A::HIDDEN_SIZE * 2 + block];
+                        sums[p] += internal::outputDotProduct<A, BLOCK_SIZE>(us, them, outputWeights);
+                    }
+
+                for (int p = 0; p < chunkSize; p++)
+                    evals[chunkStart + p] = scaleOutput(sums[p], outputBucket(numPieces[p]));
             }
+        };
+
+        numThreads = std::clamp<int>(numThreads, 1, std::max<u64>(numPositions / CHUNK_SIZE, 1));
+        u64 positionsPerThread = (numPositions + numThreads - 1) / numThreads;
+        std::vector<std::thread> threads;
+
+        for (int i = 0; i < numThreads; i++)
+        {
+            u64 start = i * positionsPerThread;
+            u64 end = std::min(numPositions, start + positionsPerThread);
+            if (start < end) threads.emplace_back(evaluateRange, start, end);
         }
-    }   
+
+        for (std::thread &thread : threads)
+            thread.join();
+    }
 };
 
-std::vector<Accumulator> accumulators;
-Accumulator *currentAccumulator;
+Network<MainArch> mainNet = Network<MainArch>(gNetFileData);
+
+// Not loaded unless the SmallEvalFile UCI option is set
+// When loaded, its accumulators are updated alongside the main net's
+Network<SmallArch> smallNet;
+
+inline void printNetInfo(std::string netName) { mainNet.printInfo(netName); }
+
+inline void useEmbeddedNet() { mainNet.useEmbedded(gNetFileData); }
 
-inline void reset()
+// The embedded net is already in use, this only checks it matches the architecture
+inline void init()
 {
-    accumulators.clear();
-    accumulators.reserve(256);
-    accumulators.push_back(Accumulator());
-    currentAccumulator = &accumulators.back();
+    if (gNetFileSize != NET_SIZE<MainArch>)
+    {
+        std::cout << "Embedded net has " << gNetFileSize << " bytes, but this build's architecture needs "
+                  << NET_SIZE<MainArch> << " bytes" << std::endl;
+        exit(1);
+    }
 }
 
-inline void push()
+inline bool loadNetFromFile(std::string filePath = "src/net.nnue")
 {
-    assert(currentAccumulator == &accumulators.back());
-    accumulators.push_back(*currentAccumulator);
-    currentAccumulator = &accumulators.back();
+    if (!mainNet.loadFromFile(filePath)) return false;
+    printNetInfo(filePath);
+    return true;
 }
 
-inline void pull()
+inline bool loadSmallNetFromFile(std::string filePath)
 {
-    accumulators.pop_back();
-    currentAccumulator = &accumulators.back();
+    if (!smallNet.loadFromFile(filePath)) return false;
+    smallNet.printInfo(filePath);
+    return true;
 }
 
-inline i32 crelu(i32 x) {
-    return std::clamp(x, 0, 255);
+inline void reset() 
+{ 
+    mainNet.reset(); 
+    if (smallNet.isLoaded()) smallNet.reset();
 }
 
-inline i32 evaluate(Color color)
-{
-    i16 *us = currentAccumulator->white,
-        *them = currentAccumulator->black;
+inline void push() 
+{ 
+    mainNet.push(); 
+    if (smallNet.isLoaded()) smallNet.push();
+}
 
-    if (color == Color::BLACK)
-    {
-        us = currentAccumulator->black;
-        them = currentAccumulator->white;
-    }
+inline void pull() 
+{ 
+    mainNet.pull(); 
+    if (smallNet.isLoaded()) smallNet.pull();
+}
 
-    i32 sum = 0;
-    for (int i = 0; i < HIDDEN_LAYER_SIZE; i++)
-    {
-        sum += crelu(us[i]) * nn->outputWeights[i];
-        sum += crelu(them[i]) * nn->outputWeights[HIDDEN_LAYER_SIZE + i];
-    }
+inline void update(Color color, PieceType pieceType, Square sq, bool activate) 
+{
+    mainNet.update(color, pieceType, sq, activate);
+    if (smallNet.isLoaded()) smallNet.update(color, pieceType, sq, activate);
+}
 
-    return (sum / NORMALIZATION_K + nn->outputBias) * SCALE / Q;
+inline i32 evaluate(Color color, u8 numPieces) {
+    return mainNet.evaluate(color, numPieces);
 }
 
+inline i32 evaluateSmall(Color color, u8 numPieces) {
+    assert(smallNet.isLoaded());
+    return smallNet.evaluate(color, numPieces);
 }
 
+}
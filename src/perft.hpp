@@ -5,7 +5,10 @@
 
 namespace perft {
 
-inline u64 perft(Board &board, int depth)
+// Perft boards track nothing, no zobrist hash nor NNUE updates
+using PerftBoard = BasicBoard<Tracking::NONE>;
+
+inline u64 perft(PerftBoard &board, int depth)
 {
     if (depth == 0) return 1;
 
@@ -24,10 +27,9 @@ inline u64 perft(Board &board, int depth)
     return nodes;
 }
 
-inline void perftSplit(Board &board, int depth)
+inline void perftSplit(Board &fromBoard, int depth)
 {
-    std::string fen = board.fen();
-    board = Board(fen, true); // second arg = true => don't update zobrist hash nor NNUE in perft
+    PerftBoard board = PerftBoard(fromBoard.fen());
 
     MovesList moves = board.pseudolegalMoves(); 
     u64 totalNodes = 0;
@@ -44,15 +46,12 @@ inline void perftSplit(Board &board, int depth)
     }
 
     std::cout << "Total: " << totalNodes << std::endl;
-
-    // rebuild board to fix zobrist hash and NNUE
-    board = Board(fen); 
 }
 
-inline u64 perftBench(Board &board, int depth)
+inline u64 perftBench(Board &fromBoard, int depth)
 {
-    std::string fen = board.fen();
-    board = Board(fen, true); // second arg = true => don't update zobrist hash nor NNUE in perft
+    std::string fen = fromBoard.fen();
+    PerftBoard board = PerftBoard(fen);
 
     std::chrono::steady_clock::time_point start =  std::chrono::steady_clock::now();
     u64 nodes = perft(board, depth);
@@ -66,9 +65,6 @@ inline u64 perftBench(Board &board, int depth)
               << " fen " << fen
               << std::endl;
 
-    // rebuild board to fix zobrist hash and NNUE
-    board = Board(fen); 
-
     return nodes;
 }
 
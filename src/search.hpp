@@ -2,10 +2,11 @@
 
 // clang-format off
 
+#include <cstring> // for memset(), memcpy()
 #include "tunable_params.hpp"
 #include "time_manager.hpp"
 #include "tt.hpp"
-#include "history_entry.hpp"
+#include "history.hpp"
 #include "see.hpp"
 #include "nnue.hpp"
 
@@ -17,6 +18,7 @@ inline void info(int depth, i16 score);
 namespace search {
 
 const u8 MAX_DEPTH = 100;
+static_assert(MAX_DEPTH < MAX_SEARCH_PLIES);
 
 // Move ordering
 const i32 TT_MOVE_SCORE           = I32_MAX,
@@ -33,46 +35,129 @@ u8 maxDepth;
 TimeManager timeManager;
 u64 nodes;
 int maxPlyReached;
-u64 movesNodes[1ULL << 16];             // [moveEncoded]
-Move pvLines[MAX_DEPTH+1][MAX_DEPTH+1]; // [ply][ply]
-int pvLengths[MAX_DEPTH+1];             // [pvLineIndex]
-int lmrTable[MAX_DEPTH+1][256];         // [depth][moveIndex]
-Move killerMoves[MAX_DEPTH];            // [ply]
-Move countermoves[2][1ULL << 16];       // [color][moveEncoded]
-HistoryEntry historyTable[2][6][64];    // [color][pieceType][targetSquare]
+
+// [depth][moveIndex]
+using LmrTable = std::array<std::array<int, 256>, MAX_DEPTH+1>;
+
+constexpr LmrTable generateLmrTable(double base, double multiplier, double (*lnFunction)(double))
+{
+    double lns[256] = {};
+    for (int i = 1; i < 256; i++)
+        lns[i] = lnFunction(i);
+
+    LmrTable table = {};
+    for (int depth = 1; depth < MAX_DEPTH+1; depth++)
+        for (int move = 1; move < 256; move++)
+        {
+            double reduction = base + lns[depth] * lns[move] * multiplier;
+            table[depth][move] = reduction < 0 ? 0 : int(reduction + 0.5); // round()
+        }
+    return table;
+}
+
+constinit LmrTable lmrTable = generateLmrTable(LMR_BASE_DEFAULT, LMR_MULTIPLIER_DEFAULT, constexprLn);
+
+// Per ply search state, the hot fields first so they share a cache line, then the PV
+struct SearchStack
+{
+    i16 eval = 0;
+    Move move = MOVE_NONE;                 // move made at this ply, MOVE_NONE for a null move
+    PieceType pieceType = PieceType::NONE; // type of the piece moved
+    Move killer = MOVE_NONE;
+    Move excludedMove = MOVE_NONE;         // TT move excluded in a singular search of this ply
+
+    // Continuation history sub-tables and countermove slot of move,
+    // for the next ply (countermove history, countermove) and the one after (follow-up move history)
+    PieceToHistory *countermoveHistory = nullptr, *followupMoveHistory = nullptr;
+    Move *countermove = nullptr;
+
+    int pvLength = 0;
+    Move pvLine[MAX_DEPTH+1];
+
+    inline void setMove(Color stm, Move move, PieceType pieceType)
+    {
+        this->move = move;
+        this->pieceType = pieceType;
+
+        if (move == MOVE_NONE)
+        {
+            countermoveHistory = followupMoveHistory = nullptr;
+            countermove = nullptr;
+            return;
+        }
+
+        int them = (int)oppColor(stm), targetSq = (int)move.to();
+        countermoveHistory = &search::countermoveHistory[them][(int)pieceType][targetSq];
+        followupMoveHistory = &search::followupMoveHistory[(int)stm][(int)pieceType][targetSq];
+        countermove = &countermoves[them][(int)pieceType][targetSq];
+    }
+};
+
+// searchStack[ply], ply -1 and -2 are the last 2 moves of the game
+SearchStack searchStackEntries[MAX_SEARCH_PLIES + 2];
+SearchStack *const searchStack = searchStackEntries + 2;
+
+// A legal root move and its statistics in the current search
+struct RootMove
+{
+    Move move = MOVE_NONE;
+    PieceType pieceType = PieceType::NONE, captured = PieceType::NONE;
+    u64 nodes = 0;           // nodes spent on this move, all iterations
+    i16 score = NEG_INFINITY; // score in the last root search, NEG_INFINITY if it didn't raise alpha
+    int selDepth = 0;
+    int pvLength = 0;
+    Move pv[MAX_DEPTH+1];
+};
+
+// Built once per search, searched in this order, sorted by score after every root search
+// rootMoves[0] is the best move
+RootMove rootMoves[256];
+int numRootMoves = 0;
 
 namespace internal
 {
+inline void initRootMoves();
 inline i16 iterativeDeepening();
 }
 
 inline void init()
 {
     tt::resize(tt::DEFAULT_SIZE_MB);
+}
 
-    // init lmrTable
-    for (int depth = 0; depth < MAX_DEPTH+1; depth++)
-        for (int move = 0; move < 256; move++)
-            lmrTable[depth][move] = depth == 0 || move == 0 
-                                    ? 0 : round(lmrBase.value + ln(depth) * ln(move) * lmrMultiplier.value);
+// Only needed when lmrBase or lmrMultiplier are changed from their defaults
+inline void initLmrTable()
+{
+    lmrTable = generateLmrTable(lmrBase.value, lmrMultiplier.value, ln);
 }
 
 inline std::pair<Move, i16> search(TimeManager _timeManager, u8 _maxDepth = MAX_DEPTH)
 {
     // reset and initialize stuff
     nodes = 0;
-    memset(movesNodes, 0, sizeof(movesNodes));
-    memset(pvLines, 0, sizeof(pvLines));
-    memset(pvLengths, 0, sizeof(pvLengths));
+
+    // Killers are kept from the last search
+    for (SearchStack &entry : searchStackEntries)
+    {
+        entry.excludedMove = MOVE_NONE;
+        entry.pvLength = 0;
+        entry.pvLine[0] = MOVE_NONE;
+    }
+
+    Color stm = board.sideToMove();
+    searchStack[-1].setMove(oppColor(stm), board.getNthToLastMove(1), board.getNthToLastMovePieceType(1));
+    searchStack[-2].setMove(stm, board.getNthToLastMove(2), board.getNthToLastMovePieceType(2));
+
     maxDepth = min(_maxDepth, MAX_DEPTH);
     timeManager = _timeManager;
 
+    internal::initRootMoves();
     i16 score = internal::iterativeDeepening();
 
     if (tt::age < 63) tt::age++;
 
     // return best move and score
-    return { pvLines[0][0], score };
+    return { numRootMoves > 0 ? rootMoves[0].move : MOVE_NONE, score };
 }
 
 inline std::pair<Move, i16> search(u8 _maxDepth = MAX_DEPTH) {
@@ -83,12 +168,80 @@ namespace internal {
 
 inline i16 aspiration(u8 iterationDepth, i16 score);
 
-inline i16 search(i16 depth, u16 ply, i16 alpha, i16 beta, bool cutNode, 
-                  i8 doubleExtensionsLeft, bool singular = false, i16 eval = 0);
+// Root and PV nodes have an open window (except PV nodes whose alpha was raised to beta - 1), non-PV nodes a null window
+enum class NodeType { ROOT, PV, NON_PV };
+
+// SINGULAR: singular search, the TT move is excluded and ss->eval is already this node's eval
+template <NodeType NODE_TYPE, bool SINGULAR = false>
+inline i16 search(i16 depth, u16 ply, i16 alpha, i16 beta, bool cutNode, i8 doubleExtensionsLeft);
 
 inline i16 qSearch(int ply, i16 alpha, i16 beta);
 
-inline std::array<i32, 256> scoreMoves(MovesList &moves, Move ttMove, Move killerMove);
+inline std::array<i32, 256> scoreMoves(MovesList &moves, Move ttMove, Move killerMove, 
+                                        NodeHistories &histories, see::NodeAttackers &seeAttackers);
+
+// Legal root moves, no underpromotions like every node
+inline void initRootMoves()
+{
+    MovesList moves = board.pseudolegalMoves(false, false);
+    numRootMoves = 0;
+    rootMoves[0] = RootMove(); // no stale PV if there are no legal moves
+
+    for (int i = 0; i < moves.size(); i++)
+    {
+        Move move = moves[i];
+
+        if (move.typeFlag() == Move::EN_PASSANT_FLAG)
+        {
+            if (!board.makeMove(move)) continue;
+            board.undoMove();
+        }
+        else if (!board.isLegal(move)) 
+            continue;
+
+        RootMove &rootMove = rootMoves[numRootMoves++];
+        rootMove = RootMove();
+        rootMove.move = move;
+        rootMove.pieceType = moves.pieceType(i);
+        rootMove.captured = moves.captured(i);
+    }
+}
+
+// Orders the root moves (and their moves list and scores) for a root search and resets their scores
+// The best move of the last root search comes first, if it raised alpha, then the others by move ordering score
+inline void orderRootMoves(MovesList &moves, std::array<i32, 256> &movesScores)
+{
+    int first = numRootMoves > 0 && rootMoves[0].score != NEG_INFINITY;
+
+    // Insertion sort by adjacent swaps, stable
+    for (int i = first + 1; i < numRootMoves; i++)
+        for (int j = i; j > first && movesScores[j] > movesScores[j - 1]; j--)
+        {
+            moves.swap(j, j - 1);
+            std::swap(movesScores[j], movesScores[j - 1]);
+            std::swap(rootMoves[j], rootMoves[j - 1]);
+        }
+
+    for (int i = 0; i < numRootMoves; i++)
+        rootMoves[i].score = NEG_INFINITY;
+}
+
+// Searches the root moves, then stable sorts them by score
+// Moves that didn't raise alpha keep their relative order, so the best move stays first if all moves fail low
+inline i16 searchRoot(i16 depth, i16 alpha, i16 beta)
+{
+    i16 score = search<NodeType::ROOT>(depth, 0, alpha, beta, false, maxDoubleExtensions.value);
+
+    // Insertion sort, stable and doesn't allocate
+    for (int i = 1; i < numRootMoves; i++)
+    {
+        RootMove *pos = std::upper_bound(rootMoves, &rootMoves[i], rootMoves[i], 
+                                         [](const RootMove &a, const RootMove &b) { return a.score > b.score; });
+        std::rotate(pos, &rootMoves[i], &rootMoves[i + 1]);
+    }
+
+    return score;
+}
 
 inline i16 iterativeDeepening()
 {
@@ -100,13 +253,13 @@ inline i16 iterativeDeepening()
 
         score = iterationDepth >= aspMinDepth.value
                 ? aspiration(iterationDepth, score) 
-                : search(iterationDepth, 0, NEG_INFINITY, POS_INFINITY, false, maxDoubleExtensions.value);
+                : searchRoot(iterationDepth, NEG_INFINITY, POS_INFINITY);
 
         if (timeManager.isHardTimeUp(nodes)) return lastScore;
 
         uci::info(iterationDepth, score);
 
-        u64 bestMoveNodes = movesNodes[pvLines[0][0].getMoveEncoded()];
+        u64 bestMoveNodes = numRootMoves > 0 ? rootMoves[0].nodes : 0;
         if (timeManager.isSoftTimeUp(nodes, bestMoveNodes)) break;
 
         lastScore = score;
@@ -127,7 +280,7 @@ inline i16 aspiration(u8 iterationDepth, i16 score)
 
     while (true)
     {
-        score = search(depth, 0, alpha, beta, false, maxDoubleExtensions.value);
+        score = searchRoot(depth, alpha, beta);
 
         if (timeManager.isHardTimeUp(nodes)) return 0;
 
@@ -152,15 +305,38 @@ inline i16 aspiration(u8 iterationDepth, i16 score)
 }
 
 inline i16 evaluate() {
-    return std::clamp(nnue::evaluate(board.sideToMove()), -MIN_MATE_SCORE + 1, MIN_MATE_SCORE - 1);
+    return std::clamp(nnue::evaluate(board.sideToMove(), std::popcount(board.occupancy())), -MIN_MATE_SCORE + 1, MIN_MATE_SCORE - 1);
 }
 
-inline i16 search(i16 depth, u16 ply, i16 alpha, i16 beta, bool cutNode, 
-                  i8 doubleExtensionsLeft, bool singular, i16 eval)
+// If a small net is loaded and its eval is far outside [alpha, beta], that eval is good enough for
+// stand pat and pruning decisions, so the main net is skipped
+// Near the window, the main net eval is used
+inline i16 evaluate(i16 alpha, i16 beta) 
 {
+    if (!nnue::smallNet.isLoaded()) return evaluate();
+
+    i32 eval = nnue::evaluateSmall(board.sideToMove(), std::popcount(board.occupancy()));
+
+    if (eval >= beta + smallNetMargin.value || eval <= alpha - smallNetMargin.value)
+        return std::clamp(eval, -MIN_MATE_SCORE + 1, MIN_MATE_SCORE - 1);
+
+    return evaluate();
+}
+
+template <NodeType NODE_TYPE, bool SINGULAR>
+inline i16 search(i16 depth, u16 ply, i16 alpha, i16 beta, bool cutNode, i8 doubleExtensionsLeft)
+{
+    constexpr bool ROOT = NODE_TYPE == NodeType::ROOT;
+    constexpr bool PV_NODE = NODE_TYPE != NodeType::NON_PV;
+    assert(ROOT == (ply == 0));
+    assert(PV_NODE || beta - alpha == 1);
+
     if (timeManager.isHardTimeUp(nodes)) return 0;
 
-    pvLengths[ply] = 0; // Ensure fresh PV
+    SearchStack *ss = &searchStack[ply];
+
+    // Ensure fresh PV, only PV nodes' PVs are read by their parent
+    if constexpr (PV_NODE) ss->pvLength = 0;
 
     // Drop into qsearch on terminal nodes
     if (depth <= 0) return qSearch(ply, alpha, beta);
@@ -168,7 +344,14 @@ inline i16 search(i16 depth, u16 ply, i16 alpha, i16 beta, bool cutNode,
     // Update seldepth
     if (ply > maxPlyReached) maxPlyReached = ply;
 
-    if (ply > 0 && board.isDraw()) return 0;
+    if (!ROOT && board.isDraw()) return 0;
+
+    // A repetition can be forced from here, so this node scores at least a draw
+    if (!ROOT && alpha < 0 && board.hasUpcomingRepetition(ply))
+    {
+        alpha = 0;
+        if (alpha >= beta) return alpha;
+    }
 
     if (ply >= maxDepth) 
         return board.inCheck() ? 0 : evaluate();
@@ -177,21 +360,21 @@ inline i16 search(i16 depth, u16 ply, i16 alpha, i16 beta, bool cutNode,
 
     // Probe TT
     auto [ttEntry, shouldCutoff] = tt::probe(board.getZobristHash(), depth, ply, alpha, beta);
-    if (shouldCutoff && !singular) 
+    if (shouldCutoff && !SINGULAR) 
         return ttEntry->adjustedScore(ply);
 
     bool ttHit = board.getZobristHash() == ttEntry->zobristHash;
     Move ttMove = ttHit ? ttEntry->bestMove : MOVE_NONE;
 
-    bool pvNode = beta - alpha > 1 || ply == 0;
-    if (cutNode) assert(!pvNode); // cutNode implies !pvNode
+    if (cutNode) assert(!PV_NODE); // cutNode implies !PV_NODE
 
     // We don't use eval in check because it's unreliable, so don't bother calculating it if in check
-    // In singular search we already have the eval, passed in the eval arg
-    if (!board.inCheck() && !singular)
-        eval = evaluate();
+    if constexpr (!SINGULAR)
+        ss->eval = board.inCheck() ? 0 : evaluate(alpha, beta);
 
-    if (!pvNode && !board.inCheck() && !singular)
+    i16 eval = ss->eval;
+
+    if (!PV_NODE && !SINGULAR && !board.inCheck())
     {
         // RFP (Reverse futility pruning) / Static NMP
         if (depth <= rfpMaxDepth.value && eval >= beta + depth * rfpDepthMultiplier.value)
@@ -208,12 +391,13 @@ inline i16 search(i16 depth, u16 ply, i16 alpha, i16 beta, bool cutNode,
         }
 
         // NMP (Null move pruning)
-        if (depth >= nmpMinDepth.value && board.getLastMove() != MOVE_NONE
+        if (depth >= nmpMinDepth.value && ss[-1].move != MOVE_NONE
         && board.hasNonPawnMaterial(board.sideToMove()) && eval >= beta)
         {
+            ss->setMove(board.sideToMove(), MOVE_NONE, PieceType::NONE);
             board.makeNullMove();
             int nmpDepth = depth - nmpBaseReduction.value - depth / nmpReductionDivisor.value - min((eval - beta)/200, 3);
-            i16 score = -search(nmpDepth, ply + 1, -beta, -alpha, !cutNode, doubleExtensionsLeft);
+            i16 score = -search<NodeType::NON_PV>(nmpDepth, ply + 1, -beta, -alpha, !cutNode, doubleExtensionsLeft);
             board.undoNullMove();
 
             if (score >= MIN_MATE_SCORE) return beta;
@@ -221,7 +405,7 @@ inline i16 search(i16 depth, u16 ply, i16 alpha, i16 beta, bool cutNode,
         }
     }
 
-    bool trySingular = !singular && depth >= singularMinDepth.value
+    bool trySingular = !ROOT && !SINGULAR && depth >= singularMinDepth.value
                        && abs(ttEntry->score) < MIN_MATE_SCORE
                        && ttEntry->depth >= depth - singularDepthMargin.value
                        && ttEntry->getBound() != tt::UPPER_BOUND;
@@ -231,35 +415,46 @@ inline i16 search(i16 depth, u16 ply, i16 alpha, i16 beta, bool cutNode,
         depth--;
 
     // generate all moves except underpromotions
-    MovesList moves = board.pseudolegalMoves(false, false); 
-    auto movesScores = scoreMoves(moves, ttMove, killerMoves[ply]);
+    MovesList moves;
+    if constexpr (ROOT)
+        // The root searches the root moves, in their order
+        for (int i = 0; i < numRootMoves; i++)
+            moves.add(rootMoves[i].move, rootMoves[i].pieceType, rootMoves[i].captured);
+    else
+        moves = board.pseudolegalMoves(false, false); 
+
+    NodeHistories histories = NodeHistories(board.sideToMove(), ss[-1].countermoveHistory, ss[-2].followupMoveHistory, ss[-1].countermove);
+    see::NodeAttackers seeAttackers = see::NodeAttackers(board);
+    auto movesScores = scoreMoves(moves, ttMove, ss->killer, histories, seeAttackers);
+    if constexpr (ROOT) orderRootMoves(moves, movesScores);
 
-    int stm = (int)board.sideToMove();
     int legalMovesPlayed = 0;
     i16 bestScore = NEG_INFINITY;
     Move bestMove = MOVE_NONE;
     i16 originalAlpha = alpha;
 
-    // Fail low quiets at beginning of array, fail low noisy moves at the end
-    HistoryEntry *failLowsHistoryEntry[256]; 
+    // Indexes in moves of the fail lows, quiets at beginning of array, noisy moves at the end
+    // (moves before the current one are already sorted, so the indexes stay valid)
+    int failLowsIdx[256];
     int numFailLowQuiets = 0, numFailLowNoisies = 0;
 
     for (int i = 0; i < moves.size(); i++)
     {
-        auto [move, moveScore] = incrementalSort(moves, movesScores, i);
+        auto [move, moveScore] = ROOT ? std::pair<Move, i32>(moves[i], movesScores[i]) 
+                                      : incrementalSort(moves, movesScores, i);
 
         // Don't search TT move in singular search
-        if (singular && move == ttMove) continue;
+        if (SINGULAR && move == ss->excludedMove) continue;
 
-        bool isQuietMove = !board.isCapture(move) && move.promotion() == PieceType::NONE;
+        bool isQuietMove = moves.captured(i) == PieceType::NONE && move.promotion() == PieceType::NONE;
         int lmr = lmrTable[depth][legalMovesPlayed + 1];
 
         // Moves loop pruning
-        if (ply > 0 && moveScore < COUNTERMOVE_SCORE && bestScore > -MIN_MATE_SCORE)
+        if (!ROOT && moveScore < COUNTERMOVE_SCORE && bestScore > -MIN_MATE_SCORE)
         {
             // LMP (Late move pruning)
             if (depth <= lmpMaxDepth.value
-            && legalMovesPlayed >= lmpMinMoves.value + pvNode + board.inCheck() + depth * depth * lmpDepthMultiplier.value)
+            && legalMovesPlayed >= lmpMinMoves.value + PV_NODE + board.inCheck() + depth * depth * lmpDepthMultiplier.value)
                 break;
 
             // FP (Futility pruning)
@@ -269,11 +464,11 @@ inline i16 search(i16 depth, u16 ply, i16 alpha, i16 beta, bool cutNode,
 
             // SEE pruning
             int threshold = isQuietMove ? depth * seeQuietThreshold.value : depth * depth * seeNoisyThreshold.value;
-            if (depth <= seePruningMaxDepth.value && !see::SEE(board, move, threshold))
+            if (depth <= seePruningMaxDepth.value && !see::SEE(board, seeAttackers, move, threshold))
                 continue;
         }
 
-        int pieceType = (int)board.pieceTypeAt(move.from());
+        int pieceType = (int)moves.pieceType(i);
         int targetSquare = (int)move.to();
 
         // skip illegal moves
@@ -284,62 +479,63 @@ inline i16 search(i16 depth, u16 ply, i16 alpha, i16 beta, bool cutNode,
         legalMovesPlayed++;
 
         int extension = 0;
-        if (ply == 0) goto skipExtensions;
-
-        // Extensions
-        // SE (Singular extensions)
-        if (trySingular && move == ttMove)
+        if constexpr (!ROOT)
         {
-            // Singular search: before searching any move, search this node at a shallower depth with TT move excluded
-
-            board.undoMove(); // undo TT move we just made
-
-            i16 singularBeta = max(NEG_INFINITY, ttEntry->score - depth * singularBetaMultiplier.value);
-            i16 singularScore = search((depth - 1) / 2, ply, singularBeta - 1, singularBeta, 
-                                       cutNode, doubleExtensionsLeft, true, eval);
-
-            board.makeMove(move, false); // second arg = false => don't check legality (we already verified it's a legal move)
-
-            // Double extension
-            if (!pvNode && doubleExtensionsLeft > 0 && singularScore < singularBeta - singularBetaMargin.value)
+            // Extensions
+            // SE (Singular extensions)
+            if (trySingular && move == ttMove)
             {
-                // singularScore is way lower than TT score
-                // TT move is probably MUCH better than all others, so extend its search by 2 plies
-                extension = 2;
-                doubleExtensionsLeft--;
+                // Singular search: before searching any move, search this node at a shallower depth with TT move excluded
+
+                board.undoMove(); // undo TT move we just made
+
+                i16 singularBeta = max(NEG_INFINITY, ttEntry->score - depth * singularBetaMultiplier.value);
+                ss->excludedMove = move;
+                i16 singularScore = search<NodeType::NON_PV, true>((depth - 1) / 2, ply, singularBeta - 1, singularBeta, cutNode, doubleExtensionsLeft);
+                ss->excludedMove = MOVE_NONE;
+
+                board.makeMove(move, false); // second arg = false => don't check legality (we already verified it's a legal move)
+
+                // Double extension
+                if (!PV_NODE && doubleExtensionsLeft > 0 && singularScore < singularBeta - singularBetaMargin.value)
+                {
+                    // singularScore is way lower than TT score
+                    // TT move is probably MUCH better than all others, so extend its search by 2 plies
+                    extension = 2;
+                    doubleExtensionsLeft--;
+                }
+                // Normal singular extension
+                else if (singularScore < singularBeta)
+                    // TT move is probably better than all others, so extend its search by 1 ply
+                    extension = 1;
+                // Negative extension
+                else if (ttEntry->score >= beta)
+                    // some other move is probably better than TT move, so reduce TT move search by 2 plies
+                    extension = -2;
+                // Cutnode negative extension
+                else if (cutNode)
+                    extension = -1;
             }
-            // Normal singular extension
-            else if (singularScore < singularBeta)
-                // TT move is probably better than all others, so extend its search by 1 ply
+            // Check extension if no singular extensions
+            else if (board.inCheck())
+                extension = 1;
+            // 7th-rank-pawn extension
+            else if (pieceType == (int)PieceType::PAWN 
+            && (squareRank(targetSquare) == Rank::RANK_2 || squareRank(targetSquare) == Rank::RANK_7))
                 extension = 1;
-            // Negative extension
-            else if (ttEntry->score >= beta)
-                // some other move is probably better than TT move, so reduce TT move search by 2 plies
-                extension = -2;
-            // Cutnode negative extension
-            else if (cutNode)
-                extension = -1;
         }
-        // Check extension if no singular extensions
-        else if (board.inCheck())
-            extension = 1;
-        // 7th-rank-pawn extension
-        else if (pieceType == (int)PieceType::PAWN 
-        && (squareRank(targetSquare) == Rank::RANK_2 || squareRank(targetSquare) == Rank::RANK_7))
-            extension = 1;
 
-        skipExtensions:
+        ss->setMove(oppColor(board.sideToMove()), move, (PieceType)pieceType);
 
         // PVS (Principal variation search)
         
         i16 score = 0, searchDepth = depth - 1 + extension;
-        HistoryEntry *historyEntry = &(historyTable[stm][pieceType][targetSquare]);
 
         // LMR (Late move reductions)
         if (legalMovesPlayed > 1 && depth >= 3 && moveScore <= KILLER_SCORE)
         {
             lmr -= board.inCheck(); // reduce checks less
-            lmr -= pvNode; // reduce pv nodes less
+            lmr -= PV_NODE; // reduce pv nodes less
 
             // reduce killers and countermoves less
             if (moveScore == KILLER_SCORE || moveScore == COUNTERMOVE_SCORE)
@@ -348,31 +544,44 @@ inline i16 search(i16 depth, u16 ply, i16 alpha, i16 beta, bool cutNode,
             else if (isQuietMove)
                 lmr -= round((moveScore - HISTORY_MOVE_BASE_SCORE) / (double)lmrHistoryDivisor.value);
             else 
-                lmr -= round(historyEntry->noisyHistory / (double)lmrNoisyHistoryDivisor.value);
+                lmr -= round(histories.noisyHistory(pieceType, targetSquare) / (double)lmrNoisyHistoryDivisor.value);
 
             // if lmr is negative, we would have an extension instead of a reduction
             // dont reduce into qsearch
             lmr = std::clamp(lmr, 0, searchDepth - 1);
 
             // PVS part 1/4: reduced search on null window
-            score = -search(searchDepth - lmr, ply + 1, -alpha-1, -alpha, true, doubleExtensionsLeft);
+            score = -search<NodeType::NON_PV>(searchDepth - lmr, ply + 1, -alpha-1, -alpha, true, doubleExtensionsLeft);
 
             // PVS part 2/4: if score is better than expected (score > alpha), do full depth search on null window
             if (score > alpha && lmr != 1)
-                score = -search(searchDepth, ply + 1, -alpha-1, -alpha, !cutNode, doubleExtensionsLeft);
+                score = -search<NodeType::NON_PV>(searchDepth, ply + 1, -alpha-1, -alpha, !cutNode, doubleExtensionsLeft);
         }
-        else if (!pvNode || legalMovesPlayed > 1)
+        else if (!PV_NODE || legalMovesPlayed > 1)
             // PVS part 3/4: full depth search on null window
-            score = -search(searchDepth, ply + 1, -alpha-1, -alpha, !cutNode, doubleExtensionsLeft);
+            score = -search<NodeType::NON_PV>(searchDepth, ply + 1, -alpha-1, -alpha, !cutNode, doubleExtensionsLeft);
 
         // PVS part 4/4: full depth search on full window for some pv nodes
-        if (pvNode && (legalMovesPlayed == 1 || score > alpha))
-            score = -search(searchDepth, ply + 1, -beta, -alpha, false, doubleExtensionsLeft);
+        if (PV_NODE && (legalMovesPlayed == 1 || score > alpha))
+            score = -search<NodeType::PV>(searchDepth, ply + 1, -beta, -alpha, false, doubleExtensionsLeft);
 
         board.undoMove();
         if (timeManager.isHardTimeUp(nodes)) return 0;
 
-        if (ply == 0) movesNodes[move.getMoveEncoded()] += nodes - prevNodes;
+        if constexpr (ROOT)
+        {
+            RootMove &rootMove = rootMoves[i];
+            rootMove.nodes += nodes - prevNodes;
+
+            if (score > alpha)
+            {
+                rootMove.score = score;
+                rootMove.selDepth = maxPlyReached;
+                rootMove.pvLength = 1 + ss[1].pvLength;
+                rootMove.pv[0] = move;
+                memcpy(&(rootMove.pv[1]), ss[1].pvLine, ss[1].pvLength * sizeof(Move));
+            }
+        }
 
         if (score > bestScore) bestScore = score;
 
@@ -380,9 +589,9 @@ inline i16 search(i16 depth, u16 ply, i16 alpha, i16 beta, bool cutNode,
         {
             // Fail low quiets at beginning of array, fail low noisy moves at the end
             if (isQuietMove)
-                failLowsHistoryEntry[numFailLowQuiets++] = historyEntry;
+                failLowsIdx[numFailLowQuiets++] = i;
             else
-                failLowsHistoryEntry[256 - ++numFailLowNoisies] = historyEntry;
+                failLowsIdx[256 - ++numFailLowNoisies] = i;
 
             continue;
         }
@@ -390,14 +599,14 @@ inline i16 search(i16 depth, u16 ply, i16 alpha, i16 beta, bool cutNode,
         alpha = score;
         bestMove = move;
 
-        if (pvNode)
+        if constexpr (PV_NODE && !ROOT) // the root's pvs are in rootMoves
         {
             // Update pv line
-            int subPvLineLength = pvLengths[ply + 1];
-            pvLengths[ply] = 1 + subPvLineLength;
-            pvLines[ply][0] = move;
+            int subPvLineLength = ss[1].pvLength;
+            ss->pvLength = 1 + subPvLineLength;
+            ss->pvLine[0] = move;
             // memcpy(dst, src, size)
-            memcpy(&(pvLines[ply][1]), pvLines[ply + 1], subPvLineLength * sizeof(Move));
+            memcpy(&(ss->pvLine[1]), ss[1].pvLine, subPvLineLength * sizeof(Move));
         }
 
         if (score < beta) continue;
@@ -409,25 +618,31 @@ inline i16 search(i16 depth, u16 ply, i16 alpha, i16 beta, bool cutNode,
         if (isQuietMove)
         {
             // This quiet move is a killer move and a countermove
-            killerMoves[ply] = move;
-            if (board.getLastMove() != MOVE_NONE)
-                countermoves[stm][board.getLastMove().getMoveEncoded()] = move;
+            ss->killer = move;
+            if (histories.countermove != nullptr)
+                *histories.countermove = move;
 
             // Increase this quiet's history
-            historyEntry->updateQuietHistory(board, historyBonus);
+            histories.updateQuietHistory(pieceType, targetSquare, historyBonus);
 
             // Penalize/decrease history of quiets that failed low
-            for (int i = 0; i < numFailLowQuiets; i++)
-                failLowsHistoryEntry[i]->updateQuietHistory(board, -historyBonus); 
+            for (int j = 0; j < numFailLowQuiets; j++)
+            {
+                int idx = failLowsIdx[j];
+                histories.updateQuietHistory((int)moves.pieceType(idx), (int)moves[idx].to(), -historyBonus);
+            }
         }
         else
         {
             // Increase history of this noisy move
-            historyEntry->updateNoisyHistory(board, historyBonus);
+            histories.updateNoisyHistory(pieceType, targetSquare, historyBonus);
 
             // Penalize/decrease history of noisy moves that failed low
-            for (int i = 255, j = 0; j < numFailLowNoisies; i--, j++)
-                failLowsHistoryEntry[i]->updateNoisyHistory(board, -historyBonus);
+            for (int j = 0; j < numFailLowNoisies; j++)
+            {
+                int idx = failLowsIdx[255 - j];
+                histories.updateNoisyHistory((int)moves.pieceType(idx), (int)moves[idx].to(), -historyBonus);
+            }
         }
 
         break; // Fail high / Beta cutoff
@@ -437,7 +652,7 @@ inline i16 search(i16 depth, u16 ply, i16 alpha, i16 beta, bool cutNode,
         // checkmate or stalemate
         return board.inCheck() ? NEG_INFINITY + ply : 0;
 
-    if (!singular)
+    if constexpr (!SINGULAR)
         tt::store(ttEntry, board.getZobristHash(), depth, bestScore, bestMove, ply, originalAlpha, beta);    
 
     return bestScore;
@@ -447,18 +662,26 @@ inline i16 qSearch(int ply, i16 alpha, i16 beta)
 {
     // Quiescence search: search noisy moves until a 'quiet' position is reached
 
+    SearchStack *ss = &searchStack[ply];
+
     // Update seldepth
     if (ply > maxPlyReached) maxPlyReached = ply;
 
     if (board.isDraw()) return 0;
 
+    if (alpha < 0 && board.hasUpcomingRepetition(ply))
+    {
+        alpha = 0;
+        if (alpha >= beta) return alpha;
+    }
+
     if (ply >= maxDepth) 
         return board.inCheck() ? 0 : evaluate();
 
     i16 eval = NEG_INFINITY; // eval is NEG_INFINITY in check
     if (!board.inCheck())
     {
-        eval = evaluate();
+        eval = evaluate(alpha, beta);
         if (eval >= beta) return eval;
         if (eval > alpha) alpha = eval;
     }
@@ -472,7 +695,9 @@ inline i16 qSearch(int ply, i16 alpha, i16 beta)
     // if in check, generate all moves, else only noisy moves
     // never generate underpromotions
     MovesList moves = board.pseudolegalMoves(!board.inCheck(), false); 
-    auto movesScores = scoreMoves(moves, ttMove, killerMoves[ply]);
+    NodeHistories histories = NodeHistories(board.sideToMove(), ss[-1].countermoveHistory, ss[-2].followupMoveHistory, ss[-1].countermove);
+    see::NodeAttackers seeAttackers = see::NodeAttackers(board);
+    auto movesScores = scoreMoves(moves, ttMove, ss->killer, histories, seeAttackers);
     
     int legalMovesPlayed = 0;
     i16 bestScore = eval;
@@ -493,6 +718,7 @@ inline i16 qSearch(int ply, i16 alpha, i16 beta)
         nodes++;
         legalMovesPlayed++;
 
+        ss->setMove(oppColor(board.sideToMove()), move, moves.pieceType(i));
         i16 score = -qSearch(ply + 1, -beta, -alpha);
         board.undoMove();
 
@@ -514,14 +740,12 @@ inline i16 qSearch(int ply, i16 alpha, i16 beta)
     return bestScore;
 }
 
-inline std::array<i32, 256> scoreMoves(MovesList &moves, Move ttMove, Move killerMove)
+// Noisy moves are ordered by SEE, the moves to the same square share their attackers in seeAttackers
+inline std::array<i32, 256> scoreMoves(MovesList &moves, Move ttMove, Move killerMove, 
+                                        NodeHistories &histories, see::NodeAttackers &seeAttackers)
 {
     std::array<i32, 256> movesScores;
-
-    int stm = (int)board.sideToMove();
-    Move countermove = board.getLastMove() == MOVE_NONE
-                       ? MOVE_NONE
-                       : countermoves[stm][board.getLastMove().getMoveEncoded()];
+    Move countermove = histories.getCountermove();
 
     for (int i = 0; i < moves.size(); i++)
     {
@@ -533,17 +757,16 @@ inline std::array<i32, 256> scoreMoves(MovesList &moves, Move ttMove, Move kille
             continue;
         }
 
-        PieceType captured = board.captured(move);
+        PieceType captured = moves.captured(i);
         PieceType promotion = move.promotion();
-        int pieceType = (int)board.pieceTypeAt(move.from());
+        int pieceType = (int)moves.pieceType(i);
         int targetSquare = (int)move.to();
-        HistoryEntry *historyEntry = &(historyTable[stm][pieceType][targetSquare]);
 
         if (captured != PieceType::NONE || promotion != PieceType::NONE)
         {
-            movesScores[i] = see::SEE(board, move) ? GOOD_NOISY_BASE_SCORE : BAD_NOISY_BASE_SCORE;
+            movesScores[i] = see::SEE(board, seeAttackers, move) ? GOOD_NOISY_BASE_SCORE : BAD_NOISY_BASE_SCORE;
             movesScores[i] += MVV_VALUES[(int)captured];
-            movesScores[i] += historyEntry->noisyHistory;
+            movesScores[i] += histories.noisyHistory(pieceType, targetSquare);
         }
         else if (move == killerMove)
             movesScores[i] = KILLER_SCORE;
@@ -552,7 +775,7 @@ inline std::array<i32, 256> scoreMoves(MovesList &moves, Move ttMove, Move kille
         else
         {
             movesScores[i] = HISTORY_MOVE_BASE_SCORE;
-            movesScores[i] += historyEntry->quietHistory(board);
+            movesScores[i] += histories.quietHistory(pieceType, targetSquare);
         }
     }
 
@@ -11,10 +11,62 @@ const u8 PAWN_INDEX = 0;
 
 inline i32 gain(Board &board, Move move);
 
-inline PieceType popLeastValuable(Board &board, u64 &occ, u64 attackers, Color color);
+inline std::pair<PieceType, Square> popLeastValuable(Board &board, u64 &occ, u64 attackers, Color color);
 
-// SEE (Static exchange evaluation)
-inline bool SEE(Board &board, Move move, i32 threshold = 0)
+// Pieces of both colors attacking square
+inline u64 attackersTo(Board &board, Square square, u64 occupancy, u64 bishops, u64 rooks)
+{
+    return (rooks & attacks::rookAttacks(square, occupancy))
+           | (bishops & attacks::bishopAttacks(square, occupancy))
+           | (board.getBitboard(Color::BLACK, PieceType::PAWN) & attacks::pawnAttacks(square, Color::WHITE))
+           | (board.getBitboard(Color::WHITE, PieceType::PAWN) & attacks::pawnAttacks(square, Color::BLACK))
+           | (board.getBitboard(PieceType::KNIGHT) & attacks::knightAttacks(square))
+           | (board.getBitboard(PieceType::KING) & attacks::kingAttacks(square));
+}
+
+// The slider that attacks square once the piece on 'through' is gone, if any
+// Only the nearest slider behind 'through' can be uncovered
+inline u64 uncoveredAttacker(Square square, Square through, u64 occupancy, u64 bishops, u64 rooks)
+{
+    u64 behind = attacks::beyond(square, through) & occupancy;
+    if (behind == 0) return 0;
+
+    Square nearest = through > square ? lsb(behind) : msb(behind);
+    bool diagonal = squareRank(through) != squareRank(square) && squareFile(through) != squareFile(square);
+    return (1ULL << nearest) & (diagonal ? bishops : rooks);
+}
+
+// What the SEE of every move of a node shares: the occupancy, the sliders and the attackers of each target square
+// Attackers are computed with the full occupancy the first time a square is asked for, then reused
+// by the other moves to that square
+struct NodeAttackers
+{
+    u64 occupancy, bishops, rooks;
+    u64 computedSquares = 0;
+    std::array<u64, 64> attackers; // [square], only valid for squares in computedSquares
+
+    inline NodeAttackers(Board &board)
+    {
+        occupancy = board.occupancy();
+        u64 queens = board.getBitboard(PieceType::QUEEN);
+        bishops = queens | board.getBitboard(PieceType::BISHOP);
+        rooks = queens | board.getBitboard(PieceType::ROOK);
+    }
+
+    inline u64 attackersTo(Board &board, Square square)
+    {
+        if ((computedSquares & (1ULL << square)) == 0)
+        {
+            computedSquares |= 1ULL << square;
+            attackers[square] = see::attackersTo(board, square, occupancy, bishops, rooks);
+        }
+
+        return attackers[square];
+    }
+};
+
+// SEE (Static exchange evaluation), with the node's shared attackers
+inline bool SEE(Board &board, NodeAttackers &node, Move move, i32 threshold = 0)
 {
     i32 score = gain(board, move) - threshold;
     if (score < 0) return false;
@@ -27,18 +79,12 @@ inline bool SEE(Board &board, Move move, i32 threshold = 0)
     Square from = move.from();
     Square square = move.to();
 
-    u64 occupancy = board.occupancy() ^ (1ULL << from) ^ (1ULL << square);
-    u64 queens = board.getBitboard(PieceType::QUEEN);
-    u64 bishops = queens | board.getBitboard(PieceType::BISHOP);
-    u64 rooks = queens | board.getBitboard(PieceType::ROOK);
+    u64 occupancy = node.occupancy ^ (1ULL << from) ^ (1ULL << square);
+    u64 bishops = node.bishops, rooks = node.rooks;
 
-    u64 attackers = 0;
-    attackers |= (rooks & attacks::rookAttacks(square, occupancy));
-    attackers |= (bishops & attacks::bishopAttacks(square, occupancy));
-    attackers |= (board.getBitboard(Color::BLACK, PieceType::PAWN) & attacks::pawnAttacks(square, Color::WHITE));
-    attackers |= (board.getBitboard(Color::WHITE, PieceType::PAWN) & attacks::pawnAttacks(square, Color::BLACK));
-    attackers |= (board.getBitboard(PieceType::KNIGHT) & attacks::knightAttacks(square));
-    attackers |= (board.getBitboard(PieceType::KING) & attacks::kingAttacks(square));
+    // The shared attackers have the full occupancy, the piece moving away can uncover a slider
+    u64 attackers = (node.attackersTo(board, square) & occupancy) 
+                    | uncoveredAttacker(square, from, occupancy, bishops, rooks);
 
     Color us = board.oppSide();
     while (true)
@@ -46,13 +92,11 @@ inline bool SEE(Board &board, Move move, i32 threshold = 0)
         u64 ourAttackers = attackers & board.getBitboard(us);
         if (ourAttackers == 0) break;
 
-        next = popLeastValuable(board, occupancy, ourAttackers, us);
-
-        if (next == PieceType::PAWN || next == PieceType::BISHOP || next == PieceType::QUEEN)
-            attackers |= attacks::bishopAttacks(square, occupancy) & bishops;
+        auto [nextPieceType, nextSquare] = popLeastValuable(board, occupancy, ourAttackers, us);
+        next = nextPieceType;
 
-        if (next == PieceType::ROOK || next == PieceType::QUEEN)
-            attackers |= attacks::rookAttacks(square, occupancy) & rooks;
+        if (next != PieceType::KING)
+            attackers |= uncoveredAttacker(square, nextSquare, occupancy, bishops, rooks);
 
         attackers &= occupancy;
         score = -score - 1 - SEE_PIECE_VALUES[(int)next];
@@ -69,6 +113,13 @@ inline bool SEE(Board &board, Move move, i32 threshold = 0)
     return board.sideToMove() != us;
 }
 
+// SEE of a single move
+inline bool SEE(Board &board, Move move, i32 threshold = 0)
+{
+    NodeAttackers node = NodeAttackers(board);
+    return SEE(board, node, move, threshold);
+}
+
 inline i32 gain(Board &board, Move move)
 {
     auto moveFlag = move.typeFlag();
@@ -89,19 +140,20 @@ inline i32 gain(Board &board, Move move)
     return score;
 }
 
-inline PieceType popLeastValuable(Board &board, u64 &occ, u64 attackers, Color color)
+inline std::pair<PieceType, Square> popLeastValuable(Board &board, u64 &occ, u64 attackers, Color color)
 {
     for (int pt = 0; pt <= 5; pt++)
     {
         u64 bb = attackers & board.getBitboard(color, (PieceType)pt);
         if (bb > 0)
         {
-            occ ^= (1ULL << lsb(bb));
-            return (PieceType)pt;
+            Square sq = lsb(bb);
+            occ ^= (1ULL << sq);
+            return { (PieceType)pt, sq };
         }
     }
 
-    return PieceType::NONE;
+    return { PieceType::NONE, SQUARE_NONE };
 }
 
 }
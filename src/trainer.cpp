@@ -0,0 +1,550 @@
+// clang-format off
+
+#include <iostream>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <filesystem>
+#include <chrono>
+#include <thread>
+#include <random>
+#include <cmath>
+#include "board.hpp"
+#include "batch_eval.hpp"
+#include "float_net.hpp"
+
+// CPU trainer for nnue::MainArch (768->384x2->1 crelu)
+// Usage: trainer <data files or folders> [-out folder] [-epochs N] [-threads N] [-lr X] [-lrdrop N] [-wdl X] [-resume checkpoint]
+// Data files are datagen output: <FEN> | <score white perspective> | <1.0 if white win OR 0.5 if draw OR 0.0 if white loss>
+// They're memory mapped, parsed by all threads and converted once to <out>/data.bin, a file of fixed size
+// training entries, which is then memory mapped and streamed in shuffled blocks every epoch
+// A .bin file given as the only data file is used directly, skipping the conversion
+// After every epoch, the float weights are saved to <out>/epoch<N>.bin (checkpoint) and quantized
+// to <out>/epoch<N>.nnue, in the nnue::NN layout, ready for EvalFile or to replace src/net.nnue
+// The optimizer state (Adam moments, step, epoch and lr) is saved next to the checkpoint, to <out>/epoch<N>.adam,
+// so -resume <out>/epoch<N>.bin continues from epoch N + 1 up to -epochs, with the saved lr (-lr is ignored)
+
+using A = nnue::MainArch;
+
+static_assert(A::OUTPUT_BUCKETS == 1 && A::ACTIVATION == nnue::Activation::CRELU,
+              "The trainer only supports one output bucket and crelu");
+
+const int FEATURES = A::FEATURES,
+          HIDDEN_SIZE = A::HIDDEN_SIZE;
+
+// All parameters in one float array, in nnue::NN order
+const u64 FEATURE_WEIGHTS = nnue::FloatNet<A>::FEATURE_WEIGHTS,
+          FEATURE_BIASES  = nnue::FloatNet<A>::FEATURE_BIASES,
+          OUTPUT_WEIGHTS  = nnue::FloatNet<A>::OUTPUT_WEIGHTS,
+          OUTPUT_BIAS     = nnue::FloatNet<A>::OUTPUT_BIAS,
+          NUM_PARAMS      = nnue::FloatNet<A>::NUM_PARAMS;
+
+const u64 BATCH_SIZE = 16384,
+          SHUFFLE_BLOCK_SIZE = 1ULL << 22,
+          MAX_VALIDATION_ENTRIES = 100'000;
+
+const float ADAM_BETA1 = 0.9,
+            ADAM_BETA2 = 0.999,
+            ADAM_EPSILON = 1e-8,
+            LR_DROP_GAMMA = 0.3;
+
+// Quantization awareness: every parameter is clipped so it fits once quantized (also see fakeQuantize())
+// Output weights (x QB) must fit in i8 and the output bias (x QA x QB) in i16
+const float MAX_PARAM = 127.0 / A::QB;
+
+struct TrainingEntry {
+    nnue::CompactPosition position;
+    i16 score; // side to move perspective
+    u8 wdl;    // side to move perspective, 0 = loss, 1 = draw, 2 = win
+} __attribute__((packed));
+
+struct TrainingOptions {
+    std::string outputFolder = "nets";
+    int epochs = 16;
+    int threads = std::max<int>(std::thread::hardware_concurrency(), 1);
+    float lr = 0.001;
+    int lrDropEpochs = 6;  // lr *= LR_DROP_GAMMA every lrDropEpochs epochs
+    float wdlWeight = 0.3; // target = (1 - wdlWeight) * sigmoid(score / SCALE) + wdlWeight * wdl
+    std::string resumeCheckpoint = "";
+};
+
+inline float sigmoid(float x) {
+    return 1.0 / (1.0 + exp(-x));
+}
+
+// Fake quantization of the output weights: the forward and backward passes see the weights rounded
+// to the QB grid they'll have once exported, while the gradients update the float weights (straight through)
+// Without it, the 1/64 resolution of the output weights costs several cp of eval per position
+inline float fakeQuantize(float outputWeight) {
+    return std::nearbyint(outputWeight * A::QB) / A::QB;
+}
+
+// Parses one datagen line, returns false if it isn't one
+inline bool parseLine(std::string_view line, TrainingEntry &entry)
+{
+    size_t firstBar = line.find('|');
+    size_t secondBar = line.find('|', firstBar + 1);
+    if (firstBar == std::string_view::npos || secondBar == std::string_view::npos)
+        return false;
+
+    if (!nnue::toCompactPosition(std::string(line.substr(0, firstBar)), entry.position))
+        return false;
+
+    std::string scoreStr = std::string(line.substr(firstBar + 1, secondBar - firstBar - 1));
+    std::string wdlStr = std::string(line.substr(secondBar + 1));
+    char *end = nullptr;
+
+    long score = strtol(scoreStr.c_str(), &end, 10);
+    if (end == scoreStr.c_str()) return false;
+
+    double wdl = strtod(wdlStr.c_str(), &end);
+    if (end == wdlStr.c_str()) return false;
+
+    // White perspective to side to move perspective
+    bool whiteToMove = entry.position.sideToMove == Color::WHITE;
+    entry.score = std::clamp<long>(whiteToMove ? score : -score, -32000, 32000);
+    entry.wdl = std::clamp<int>(lround((whiteToMove ? wdl : 1.0 - wdl) * 2), 0, 2);
+    return true;
+}
+
+// Converts the datagen files to one file of TrainingEntry
+// Each file is memory mapped and split between threads at line boundaries
+inline u64 convertDataFiles(std::vector<std::string> &dataFiles, std::string binFilePath, int numThreads)
+{
+    std::ofstream binFile(binFilePath, std::ios::binary);
+    if (!binFile.is_open())
+    {
+        std::cout << "Error creating " << binFilePath << std::endl;
+        exit(1);
+    }
+
+    u64 numEntries = 0, numSkipped = 0;
+
+    for (std::string &filePath : dataFiles)
+    {
+        u64 fileSize = 0;
+        const char *data = (const char*)nnue::internal::mapFile(filePath, fileSize);
+        if (data == nullptr)
+        {
+            std::cout << "Error opening " << filePath << ", skipping it" << std::endl;
+            continue;
+        }
+
+        std::vector<std::vector<TrainingEntry>> threadEntries(numThreads);
+        std::vector<u64> threadSkipped(numThreads, 0);
+        std::vector<std::thread> threads;
+
+        for (int t = 0; t < numThreads; t++)
+            threads.emplace_back([&, t]()
+            {
+                // This thread parses the lines that start in [start, end)
+                u64 start = fileSize * t / numThreads, end = fileSize * (t + 1) / numThreads;
+                while (start > 0 && start < fileSize && data[start - 1] != '\n') start++;
+
+                while (start < end)
+                {
+                    const char *newLine = (const char*)memchr(data + start, '\n', fileSize - start);
+                    u64 lineEnd = newLine == nullptr ? fileSize : newLine - data;
+
+                    TrainingEntry entry;
+                    if (parseLine(std::string_view(data + start, lineEnd - start), entry))
+                        threadEntries[t].push_back(entry);
+                    else
+                        threadSkipped[t] += lineEnd > start;
+
+                    start = lineEnd + 1;
+                }
+            });
+
+        for (std::thread &thread : threads)
+            thread.join();
+
+        for (int t = 0; t < numThreads; t++)
+        {
+            binFile.write((const char*)threadEntries[t].data(), threadEntries[t].size() * sizeof(TrainingEntry));
+            numEntries += threadEntries[t].size();
+            numSkipped += threadSkipped[t];
+        }
+
+        nnue::internal::unmapFile((void*)data, fileSize);
+        std::cout << "Converted " << filePath << ", total positions " << numEntries << std::endl;
+    }
+
+    std::cout << "Skipped " << numSkipped << " lines that aren't datagen lines" << std::endl;
+    return numEntries;
+}
+
+// Forward pass of one position in float
+struct Forward
+{
+    alignas(64) float us[HIDDEN_SIZE], them[HIDDEN_SIZE];
+    u16 usFeatures[32], themFeatures[32];
+    int numFeatures;
+    float output; // logit, output * SCALE is the eval in centipawns
+
+    inline Forward(const nnue::CompactPosition &position, const float *params)
+    {
+        numFeatures = position.features(usFeatures, themFeatures);
+
+        for (int i = 0; i < HIDDEN_SIZE; i++)
+            us[i] = them[i] = params[FEATURE_BIASES + i];
+
+        // Sparse input: only the rows of the active features
+        for (int k = 0; k < numFeatures; k++)
+        {
+            const float *usWeights = &params[FEATURE_WEIGHTS + usFeatures[k] * HIDDEN_SIZE];
+            const float *themWeights = &params[FEATURE_WEIGHTS + themFeatures[k] * HIDDEN_SIZE];
+
+            for (int i = 0; i < HIDDEN_SIZE; i++)
+            {
+                us[i] += usWeights[i];
+                them[i] += themWeights[i];
+            }
+        }
+
+        // QA is 1.0 in float
+        const float *outputWeights = &params[OUTPUT_WEIGHTS];
+        output = params[OUTPUT_BIAS];
+
+        for (int i = 0; i < HIDDEN_SIZE; i++)
+            output += std::clamp<float>(us[i], 0, 1) * fakeQuantize(outputWeights[i])
+                      + std::clamp<float>(them[i], 0, 1) * fakeQuantize(outputWeights[HIDDEN_SIZE + i]);
+    }
+};
+
+// Forward pass, and backward pass into gradients if not nullptr
+// Returns the loss
+inline float trainEntry(const TrainingEntry &entry, const float *params, float *gradients, float wdlWeight)
+{
+    Forward forward = Forward(entry.position, params);
+    const float *us = forward.us, *them = forward.them;
+    const float *outputWeights = &params[OUTPUT_WEIGHTS];
+
+    float prediction = sigmoid(forward.output);
+    float target = (1.0 - wdlWeight) * sigmoid((float)entry.score / A::SCALE) + wdlWeight * entry.wdl / 2.0;
+    float error = prediction - target;
+
+    if (gradients == nullptr) return error * error;
+
+    float outputGradient = 2.0 * error * prediction * (1.0 - prediction);
+    gradients[OUTPUT_BIAS] += outputGradient;
+
+    alignas(64) float usGradients[HIDDEN_SIZE], themGradients[HIDDEN_SIZE];
+
+    for (int i = 0; i < HIDDEN_SIZE; i++)
+    {
+        gradients[OUTPUT_WEIGHTS + i] += outputGradient * std::clamp<float>(us[i], 0, 1);
+        gradients[OUTPUT_WEIGHTS + HIDDEN_SIZE + i] += outputGradient * std::clamp<float>(them[i], 0, 1);
+
+        usGradients[i] = us[i] > 0 && us[i] < 1 ? outputGradient * fakeQuantize(outputWeights[i]) : 0;
+        themGradients[i] = them[i] > 0 && them[i] < 1 ? outputGradient * fakeQuantize(outputWeights[HIDDEN_SIZE + i]) : 0;
+
+        gradients[FEATURE_BIASES + i] += usGradients[i] + themGradients[i];
+    }
+
+    for (int k = 0; k < forward.numFeatures; k++)
+    {
+        float *usWeightGradients = &gradients[FEATURE_WEIGHTS + forward.usFeatures[k] * HIDDEN_SIZE];
+        float *themWeightGradients = &gradients[FEATURE_WEIGHTS + forward.themFeatures[k] * HIDDEN_SIZE];
+
+        for (int i = 0; i < HIDDEN_SIZE; i++)
+        {
+            usWeightGradients[i] += usGradients[i];
+            themWeightGradients[i] += themGradients[i];
+        }
+    }
+
+    return error * error;
+}
+
+// Runs func(thread index, start, end) on numThreads threads, splitting [0, size)
+template <typename F>
+inline void parallelFor(int numThreads, u64 size, F &&func)
+{
+    std::vector<std::thread> threads;
+
+    for (int t = 0; t < numThreads; t++)
+    {
+        u64 start = size * t / numThreads, end = size * (t + 1) / numThreads;
+        if (start < end) threads.emplace_back(func, t, start, end);
+    }
+
+    for (std::thread &thread : threads)
+        thread.join();
+}
+
+// Optimizer state saved with every checkpoint, so resuming continues the Adam moments, bias correction,
+// lr schedule and epoch numbering
+struct OptimizerState {
+    std::vector<float> adamM = std::vector<float>(NUM_PARAMS, 0), 
+                       adamV = std::vector<float>(NUM_PARAMS, 0);
+    u64 step = 0;
+    i32 epoch = 0; // epochs done
+    float lr = 0;
+
+    inline bool load(std::string filePath)
+    {
+        std::ifstream file(filePath, std::ios::binary | std::ios::ate);
+        const u64 EXPECTED_SIZE = sizeof(step) + sizeof(epoch) + sizeof(lr) + NUM_PARAMS * sizeof(float) * 2;
+
+        if (!file.is_open() || (u64)file.tellg() != EXPECTED_SIZE)
+        {
+            std::cout << "Error loading optimizer state " << filePath << ": expected "
+                      << EXPECTED_SIZE << " bytes" << std::endl;
+            return false;
+        }
+
+        file.seekg(0);
+        file.read((char*)&step, sizeof(step));
+        file.read((char*)&epoch, sizeof(epoch));
+        file.read((char*)&lr, sizeof(lr));
+        file.read((char*)adamM.data(), NUM_PARAMS * sizeof(float));
+        file.read((char*)adamV.data(), NUM_PARAMS * sizeof(float));
+        return true;
+    }
+
+    inline bool save(std::string filePath)
+    {
+        std::ofstream file(filePath, std::ios::binary);
+        if (!file.is_open())
+        {
+            std::cout << "Error creating " << filePath << std::endl;
+            return false;
+        }
+
+        file.write((const char*)&step, sizeof(step));
+        file.write((const char*)&epoch, sizeof(epoch));
+        file.write((const char*)&lr, sizeof(lr));
+        file.write((const char*)adamM.data(), NUM_PARAMS * sizeof(float));
+        file.write((const char*)adamV.data(), NUM_PARAMS * sizeof(float));
+        return true;
+    }
+};
+
+inline bool writeFile(std::string filePath, const void *data, u64 size)
+{
+    std::ofstream file(filePath, std::ios::binary);
+    if (!file.is_open())
+    {
+        std::cout << "Error creating " << filePath << std::endl;
+        return false;
+    }
+
+    file.write((const char*)data, size);
+    return true;
+}
+
+int main(int argc, char* argv[])
+{
+    TrainingOptions options;
+    std::vector<std::string> dataFiles;
+
+    for (int i = 1; i < argc; i++)
+    {
+        std::string arg = argv[i];
+        bool hasValue = i + 1 < argc;
+
+        if (arg == "-out" && hasValue) options.outputFolder = argv[++i];
+        else if (arg == "-epochs" && hasValue) options.epochs = atoi(argv[++i]);
+        else if (arg == "-threads" && hasValue) options.threads = std::max(atoi(argv[++i]), 1);
+        else if (arg == "-lr" && hasValue) options.lr = atof(argv[++i]);
+        else if (arg == "-lrdrop" && hasValue) options.lrDropEpochs = std::max(atoi(argv[++i]), 1);
+        else if (arg == "-wdl" && hasValue) options.wdlWeight = atof(argv[++i]);
+        else if (arg == "-resume" && hasValue) options.resumeCheckpoint = argv[++i];
+        else if (std::filesystem::is_directory(arg))
+        {
+            for (auto &file : std::filesystem::directory_iterator(arg))
+                if (file.is_regular_file()) dataFiles.push_back(file.path().string());
+        }
+        else
+            dataFiles.push_back(arg);
+    }
+
+    if (dataFiles.size() == 0)
+    {
+        std::cout << "Usage: trainer <data files or folders> [-out folder] [-epochs N] [-threads N] [-lr X] [-lrdrop N] [-wdl X] [-resume checkpoint]" << std::endl;
+        return 1;
+    }
+
+    if (!std::filesystem::exists(options.outputFolder))
+        std::filesystem::create_directory(options.outputFolder);
+
+    // Training data
+    std::string binFilePath = options.outputFolder + "/data.bin";
+
+    if (dataFiles.size() == 1 && dataFiles[0].ends_with(".bin"))
+        binFilePath = dataFiles[0];
+    else
+        convertDataFiles(dataFiles, binFilePath, options.threads);
+
+    u64 binFileSize = 0;
+    const TrainingEntry *entries = (const TrainingEntry*)nnue::internal::mapFile(binFilePath, binFileSize);
+    u64 numEntries = binFileSize / sizeof(TrainingEntry);
+
+    if (entries == nullptr || numEntries < 2)
+    {
+        std::cout << "No training data in " << binFilePath << std::endl;
+        return 1;
+    }
+
+    // The last entries are the validation set
+    u64 numValidation = std::min<u64>(numEntries / 100 + 1, MAX_VALIDATION_ENTRIES);
+    u64 numTraining = numEntries - numValidation;
+
+    std::cout << "Training on " << numTraining << " positions, validating on " << numValidation
+              << ", " << options.threads << " threads" << std::endl;
+
+    // Weights, optimizer state and per thread gradients
+    // The reduction zeroes the gradients it sums, so every thread starts each batch from zero gradients
+    nnue::FloatNet<A> floatNet;
+    std::vector<float> &params = floatNet.params;
+    OptimizerState optimizer;
+    std::vector<float> &adamM = optimizer.adamM, &adamV = optimizer.adamV;
+    std::vector<std::vector<float>> threadGradients(options.threads, std::vector<float>(NUM_PARAMS, 0));
+    optimizer.lr = options.lr;
+
+    std::mt19937 gen(12345);
+
+    if (options.resumeCheckpoint != "")
+    {
+        if (!floatNet.load(options.resumeCheckpoint)) return 1;
+
+        std::string optimizerPath = std::filesystem::path(options.resumeCheckpoint).replace_extension(".adam").string();
+
+        if (!std::filesystem::exists(optimizerPath))
+            std::cout << "No optimizer state " << optimizerPath << ", Adam moments, lr and epochs restart" << std::endl;
+        else if (!optimizer.load(optimizerPath))
+            return 1;
+        else
+            std::cout << "Resuming after epoch " << optimizer.epoch << ", step " << optimizer.step
+                      << ", lr " << optimizer.lr << std::endl;
+
+        // Don't replay the shuffles of the first epochs (the original run's generator state isn't saved)
+        gen.seed(12345 + optimizer.epoch);
+    }
+    else
+    {
+        // Each position has ~32 active features
+        std::normal_distribution<float> featureWeightDistribution(0, 1.0 / sqrt(32));
+        std::normal_distribution<float> outputWeightDistribution(0, 1.0 / sqrt(HIDDEN_SIZE * 2));
+
+        for (u64 i = 0; i < FEATURES * HIDDEN_SIZE; i++)
+            params[FEATURE_WEIGHTS + i] = featureWeightDistribution(gen);
+
+        for (u64 i = 0; i < HIDDEN_SIZE * 2; i++)
+            params[OUTPUT_WEIGHTS + i] = outputWeightDistribution(gen);
+    }
+
+    std::vector<TrainingEntry> block;
+    u64 numBlocks = (numTraining + SHUFFLE_BLOCK_SIZE - 1) / SHUFFLE_BLOCK_SIZE;
+    std::vector<u64> blockOrder(numBlocks);
+    for (u64 i = 0; i < numBlocks; i++)
+        blockOrder[i] = i;
+
+    std::unique_ptr<nnue::NN<A>> quantized = std::make_unique<nnue::NN<A>>();
+    u64 &step = optimizer.step;
+    float &lr = optimizer.lr;
+
+    for (int epoch = optimizer.epoch + 1; epoch <= options.epochs; epoch++)
+    {
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        double epochLoss = 0;
+        u64 epochPositions = 0;
+
+        std::shuffle(blockOrder.begin(), blockOrder.end(), gen);
+
+        for (u64 blockIdx : blockOrder)
+        {
+            u64 blockStart = blockIdx * SHUFFLE_BLOCK_SIZE;
+            block.assign(entries + blockStart, entries + std::min(numTraining, blockStart + SHUFFLE_BLOCK_SIZE));
+            std::shuffle(block.begin(), block.end(), gen);
+
+            for (u64 batchStart = 0; batchStart < block.size(); batchStart += BATCH_SIZE)
+            {
+                u64 batchSize = std::min<u64>(BATCH_SIZE, block.size() - batchStart);
+                std::vector<double> threadLoss(options.threads, 0);
+
+                // Forward and backward, each thread into its own gradients
+                parallelFor(options.threads, batchSize, [&](int t, u64 start, u64 end)
+                {
+                    for (u64 i = start; i < end; i++)
+                        threadLoss[t] += trainEntry(block[batchStart + i], params.data(), threadGradients[t].data(), options.wdlWeight);
+                });
+
+                // Sum the gradients of the threads and apply AdamW, each thread on its own range of parameters
+                // All threads are summed, since on a short batch parallelFor skips threads in the middle (their gradients are 0)
+                step++;
+                float lrCorrected = lr * sqrt(1.0 - pow(ADAM_BETA2, step)) / (1.0 - pow(ADAM_BETA1, step));
+
+                parallelFor(options.threads, NUM_PARAMS, [&](int, u64 start, u64 end)
+                {
+                    for (u64 i = start; i < end; i++)
+                    {
+                        float gradient = 0;
+                        for (int t = 0; t < options.threads; t++)
+                        {
+                            gradient += threadGradients[t][i];
+                            threadGradients[t][i] = 0;
+                        }
+                        gradient /= batchSize;
+
+                        adamM[i] = ADAM_BETA1 * adamM[i] + (1 - ADAM_BETA1) * gradient;
+                        adamV[i] = ADAM_BETA2 * adamV[i] + (1 - ADAM_BETA2) * gradient * gradient;
+                        params[i] -= lrCorrected * adamM[i] / (sqrt(adamV[i]) + ADAM_EPSILON) + lr * 0.01 * params[i];
+                        params[i] = std::clamp<float>(params[i], -MAX_PARAM, MAX_PARAM);
+                    }
+                });
+
+                for (double loss : threadLoss)
+                    epochLoss += loss;
+                epochPositions += batchSize;
+            }
+
+            double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+            std::cout << "Epoch " << epoch
+                      << ", " << epochPositions << "/" << numTraining << " positions"
+                      << ", loss " << epochLoss / epochPositions
+                      << ", " << (u64)(epochPositions / seconds) << " positions/s"
+                      << std::endl;
+        }
+
+        // Validation: float loss, and how far the quantized net's evals are from the float net's
+        double validationLoss = 0, quantizationError = 0;
+        floatNet.quantize(*quantized);
+        nnue::Network<A> quantizedNet = nnue::Network<A>(quantized.get());
+
+        std::vector<nnue::CompactPosition> validationPositions(numValidation);
+        std::vector<i32> quantizedEvals(numValidation);
+
+        for (u64 i = 0; i < numValidation; i++)
+            validationPositions[i] = entries[numTraining + i].position;
+
+        quantizedNet.evaluateBatch(validationPositions.data(), quantizedEvals.data(), numValidation, options.threads);
+
+        for (u64 i = 0; i < numValidation; i++)
+        {
+            const TrainingEntry &entry = entries[numTraining + i];
+            validationLoss += trainEntry(entry, params.data(), nullptr, options.wdlWeight);
+            quantizationError += fabs(Forward(entry.position, params.data()).output * A::SCALE - quantizedEvals[i]);
+        }
+
+        if (epoch % options.lrDropEpochs == 0)
+            lr *= LR_DROP_GAMMA;
+
+        optimizer.epoch = epoch;
+
+        std::string epochPath = options.outputFolder + "/epoch" + std::to_string(epoch);
+        floatNet.save(epochPath + ".bin");
+        optimizer.save(epochPath + ".adam");
+        writeFile(epochPath + ".nnue", quantized.get(), nnue::NET_SIZE<A>);
+
+        std::cout << "Epoch " << epoch << " done"
+                  << ", validation loss " << validationLoss / numValidation
+                  << ", mean quantization error " << quantizationError / numValidation << " cp"
+                  << ", saved " << epochPath << ".nnue"
+                  << std::endl;
+    }
+
+    nnue::internal::unmapFile((void*)entries, binFileSize);
+    return 0;
+}
@@ -2,7 +2,8 @@
 
 // clang-format off
 
-#include <cstring> // for memset()
+#include <cstdlib>   // for calloc(), free(), exit()
+#include <algorithm> // for std::fill()
 
 namespace tt { // Transposition table
 
@@ -50,25 +51,57 @@ struct Entry
 
 } __attribute__((packed)); 
 
-std::vector<Entry> tt;
+// Allocated with calloc(): a block this large comes straight from the OS as zero pages that are only
+// mapped on first access, so resizing doesn't write the whole table up front
+Entry *tt = nullptr;
+u64 numEntries = 0;
+bool isEmpty = true; // nothing stored since the last resize/reset, so clearing can be skipped
 
+// If the new size can't be allocated, the current table is kept (or the default size is used if there's none)
 inline void resize(u16 sizeMB)
 {
-    tt.clear();
-    u32 numEntries = sizeMB * 1024 * 1024 / sizeof(Entry);
-    tt.resize(numEntries);
+    u64 newNumEntries = (u64)sizeMB * 1024 * 1024 / sizeof(Entry);
+    Entry *newTT = (Entry*)calloc(newNumEntries, sizeof(Entry));
+
+    if (newTT == nullptr)
+    {
+        std::cout << "Error allocating TT of " << sizeMB << " MB";
+
+        if (tt != nullptr)
+        {
+            std::cout << ", keeping the current one (" << numEntries << " entries)" << std::endl;
+            return;
+        }
+
+        std::cout << ", using " << DEFAULT_SIZE_MB << " MB" << std::endl;
+        sizeMB = DEFAULT_SIZE_MB;
+        newNumEntries = (u64)sizeMB * 1024 * 1024 / sizeof(Entry);
+        newTT = (Entry*)calloc(newNumEntries, sizeof(Entry));
+
+        if (newTT == nullptr)
+        {
+            std::cout << "Error allocating TT of " << sizeMB << " MB" << std::endl;
+            exit(1);
+        }
+    }
+
+    free(tt);
+    tt = newTT;
+    numEntries = newNumEntries;
+    isEmpty = true;
     std::cout << "TT size: " << sizeMB << " MB (" << numEntries << " entries)" << std::endl;
 }
 
 inline void reset()
 {
-    memset(tt.data(), 0, sizeof(Entry) * tt.size());
+    if (!isEmpty) std::fill(tt, tt + numEntries, Entry());
+    isEmpty = true;
     age = 0;
 }
 
 inline std::pair<Entry*, bool> probe(u64 zobristHash, int depth, int plyFromRoot, i16 alpha, i16 beta)
 {
-    Entry *ttEntry = &(tt[zobristHash % tt.size()]);
+    Entry *ttEntry = &(tt[zobristHash % numEntries]);
     u8 ttEntryBound = ttEntry->getBound();
 
     bool shouldCutoff = plyFromRoot > 0 
@@ -96,6 +129,7 @@ inline void store(Entry *ttEntry, u64 zobristHash, int depth, i16 score, Move be
     && ttEntry->getAge() == age)   // always replace entries from previous searches ('go' commands)
         return;
 
+    isEmpty = false;
     ttEntry->zobristHash = zobristHash;
     ttEntry->depth = depth;
     ttEntry->score = score;
@@ -59,15 +59,20 @@ TunableParam<u8> singularBetaMargin = TunableParam<u8>("singularBetaMargin", 23,
 TunableParam<u8> maxDoubleExtensions = TunableParam<u8>("maxDoubleExtensions", 6, 4, 10); // step = 3
 
 // LMR (Late move reductions)
-TunableParam<double> lmrBase = TunableParam<double>("lmrBase", 0.83, 0.6, 1.0); // step = 0.1
-TunableParam<double> lmrMultiplier = TunableParam<double>("lmrMultiplier", 0.4, 0.3, 0.6); // step = 0.1
+// The default lmrTable is generated at compile time from the default lmrBase and lmrMultiplier
+constexpr double LMR_BASE_DEFAULT = 0.83, LMR_MULTIPLIER_DEFAULT = 0.4;
+TunableParam<double> lmrBase = TunableParam<double>("lmrBase", LMR_BASE_DEFAULT, 0.6, 1.0); // step = 0.1
+TunableParam<double> lmrMultiplier = TunableParam<double>("lmrMultiplier", LMR_MULTIPLIER_DEFAULT, 0.3, 0.6); // step = 0.1
 TunableParam<u16> lmrHistoryDivisor = TunableParam<u16>("lmrHistoryDivisor", 14620, 4096, 16384); // step = 4096
 TunableParam<u16> lmrNoisyHistoryDivisor = TunableParam<u16>("lmrNoisyHistoryDivisor", 6689, 2048, 8192); // step = 2048
 
 // History
 TunableParam<u16> historyMaxBonus = TunableParam<u16>("historyMaxBonus", 1747, 1300, 1800); // step = 250
 TunableParam<u16> historyBonusMultiplier = TunableParam<u16>("historyBonusMultiplier", 432, 270, 470); // step = 100
-TunableParam<u16> historyMax = TunableParam<u16>("historyMax", 17360, 16384, 32768); // step = 16384
+TunableParam<u16> historyMax = TunableParam<u16>("historyMax", 17360, 16384, 32767); // step = 16384, at most I16_MAX since histories are i16
+
+// Small net, used when its eval is at least this far outside the window
+TunableParam<u16> smallNetMargin = TunableParam<u16>("smallNetMargin", 400, 200, 800); // step = 100
 
 // Time management
 TunableParam<double> suddenDeathHardTimePercentage = TunableParam<double>("suddenDeathHardTimePercentage", 0.45, 0.35, 0.65); // step = 0.15
@@ -91,6 +96,7 @@ std::vector<TunableParamVariant> tunableParams {
     &singularMinDepth, &singularDepthMargin, &singularBetaMultiplier, &singularBetaMargin, &maxDoubleExtensions,
     &lmrBase, &lmrMultiplier, &lmrHistoryDivisor, &lmrNoisyHistoryDivisor,
     &historyMaxBonus, &historyBonusMultiplier, &historyMax,
+    &smallNetMargin,
     &suddenDeathHardTimePercentage, &suddenDeathSoftTimePercentage,
     &movesToGoHardTimePercentage, &movesToGoSoftTimePercentage,
     &softTimeScaleBase, &softTimeScaleMultiplier
@@ -22,6 +22,12 @@ const std::string START_FEN = "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQk
 
 const Square SQUARE_NONE = 255;
 
+// Board states and nnue accumulators are kept in fixed capacity stacks, allocated once per board/net,
+// with room for the game history plus the deepest search line, so make/undo never touch the heap
+const int MAX_GAME_PLIES = 1024, 
+          MAX_SEARCH_PLIES = 128,
+          STACK_CAPACITY = MAX_GAME_PLIES + MAX_SEARCH_PLIES;
+
 enum class Color : i8
 {
     WHITE = 0,
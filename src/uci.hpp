@@ -4,16 +4,32 @@
 
 #include "bench.hpp"
 #include "perft.hpp"
+#include "net_pruning.hpp"
+#include "batch_eval.hpp"
 
 namespace uci { // Universal chess interface
 
 bool outputSearchInfo = true;
 
+// Prune dead neurons of the current net, sampling the bench positions or the positions in a file
+inline void pruneNet(std::string filePath = "")
+{
+    std::vector<std::string> fens = filePath == "" 
+                                    ? std::vector<std::string>(bench::FENS.begin(), bench::FENS.end())
+                                    : readFens(filePath);
+
+    std::string fen = board.fen();
+    nnue::pruneDeadNeurons(fens);
+    board = Board(fen); // rebuild board to refresh NNUE accumulators with the pruned net
+}
+
 inline void setoption(std::vector<std::string> &tokens) // e.g. "setoption name Hash value 32"
 {
     std::string optionName = tokens[2];
     trim(optionName);
     std::string optionValue = tokens[4];
+    for (size_t i = 5; i < tokens.size(); i++)
+        optionValue += " " + tokens[i]; // file paths may contain spaces
     trim(optionValue);
 
     if (optionName == "Hash" || optionName == "hash")
@@ -21,6 +37,48 @@ inline void setoption(std::vector<std::string> &tokens) // e.g. "setoption name
         int ttSizeMB = stoi(optionValue);
         tt::resize(ttSizeMB);
     }
+    else if (optionName == "EvalFile")
+    {
+        if (optionValue == nnue::EMBEDDED_NET_NAME)
+        {
+            nnue::useEmbeddedNet();
+            nnue::printNetInfo(nnue::EMBEDDED_NET_NAME);
+        }
+        else if (!nnue::loadNetFromFile(optionValue))
+            return;
+
+        if (nnue::pruneNetOnLoad) pruneNet();
+
+        // rebuild board to refresh NNUE accumulators with the new net
+        board = Board(board.fen());
+    }
+    else if (optionName == "SmallEvalFile")
+    {
+        if (optionValue == nnue::NO_NET_NAME)
+            nnue::smallNet.unload();
+        else if (!nnue::loadSmallNetFromFile(optionValue))
+            return;
+
+        // rebuild board to create or drop the small net accumulators
+        board = Board(board.fen());
+    }
+    else if (optionName == "PextAttacks")
+    {
+        if (!attacks::setPext(optionValue == "true"))
+            std::cout << "PEXT attacks need a build with BMI2 (e.g. -march=native on a BMI2 CPU)" << std::endl;
+    }
+    else if (optionName == "PruneNet")
+    {
+        nnue::pruneNetOnLoad = optionValue == "true";
+
+        if (nnue::pruneNetOnLoad) 
+            pruneNet();
+        else
+            nnue::mainNet.pack(); // back to the full net
+
+        // rebuild board to refresh NNUE accumulators with the new net
+        board = Board(board.fen());
+    }
     else
     {
         bool found = false;
@@ -36,7 +94,7 @@ inline void setoption(std::vector<std::string> &tokens) // e.g. "setoption name
                         search::BAD_NOISY_BASE_SCORE = -search::historyMax.value / 2;
                     else if (tunableParam->name == search::lmrBase.name 
                     || tunableParam->name == search::lmrMultiplier.name)
-                        search::init();
+                        search::initLmrTable();
                 }
             }, myTunableParam);
 
@@ -48,9 +106,9 @@ inline void setoption(std::vector<std::string> &tokens) // e.g. "setoption name
 inline void ucinewgame()
 {
     tt::reset();
-    memset(search::historyTable, 0, sizeof(search::historyTable)); // reset/clear histories
-    memset(search::killerMoves, 0, sizeof(search::killerMoves));   // reset/clear killer moves
-    memset(search::countermoves, 0, sizeof(search::countermoves)); // reset/clear countermoves
+    search::clearHistories();                                    // reset/clear histories and countermoves
+    for (search::SearchStack &entry : search::searchStackEntries)  // reset/clear killer moves
+        entry = search::SearchStack();
 }
 
 inline void position(std::vector<std::string> &tokens)
@@ -73,8 +131,11 @@ inline void position(std::vector<std::string> &tokens)
         movesTokenIndex = i;
     }
 
-    for (int i = movesTokenIndex + 1; i < tokens.size(); i++)
+    for (size_t i = movesTokenIndex + 1; i < tokens.size(); i++)
+    {
         board.makeMove(tokens[i]);
+        board.trimHistory(); // long games keep only the moves repetition detection needs
+    }
 }
 
 inline void go(std::vector<std::string> &tokens)
@@ -136,12 +197,13 @@ inline void info(int depth, i16 score)
     }
 
     // Collect PV
-    std::string strPv = search::pvLines[0][0].toUci();
-    for (int i = 1; i < search::pvLengths[0]; i++)
-        strPv += " " + search::pvLines[0][i].toUci();
+    search::RootMove &bestRootMove = search::rootMoves[0];
+    std::string strPv = bestRootMove.pv[0].toUci();
+    for (int i = 1; i < bestRootMove.pvLength; i++)
+        strPv += " " + bestRootMove.pv[i].toUci();
 
     std::cout << "info depth " << depth
-        << " seldepth " << search::maxPlyReached
+        << " seldepth " << bestRootMove.selDepth
         << " time " << round(millisecondsElapsed)
         << " nodes " << search::nodes
         << " nps " << nps
@@ -162,6 +224,10 @@ inline void uciLoop()
     std::cout << "id name Starzix\n";
     std::cout << "id author zzzzz\n";
     std::cout << "option name Hash type spin default " << tt::DEFAULT_SIZE_MB << " min 1 max 1024\n";
+    std::cout << "option name EvalFile type string default " << nnue::EMBEDDED_NET_NAME << "\n";
+    std::cout << "option name PruneNet type check default false\n";
+    std::cout << "option name SmallEvalFile type string default " << nnue::NO_NET_NAME << "\n";
+    std::cout << "option name PextAttacks type check default " << (attacks::isUsingPext() ? "true" : "false") << "\n";
 
     
     for (auto &myTunableParam : search::tunableParams) 
@@ -211,12 +277,24 @@ inline void uciLoop()
         else if (tokens[0] == "go")
             go(tokens);
         else if (tokens[0] == "eval")
-            std::cout << "eval " << nnue::evaluate(board.sideToMove()) << " cp" << std::endl;
+            std::cout << "eval " << nnue::evaluate(board.sideToMove(), std::popcount(board.occupancy())) << " cp" << std::endl;
         else if (tokens[0] == "bench")
         {
             u8 depth = tokens.size() > 1 ? stoi(tokens[1]) : bench::DEFAULT_DEPTH;
             bench::bench(depth);
         }
+        else if (tokens[0] == "attacksbench")
+            bench::attacksBench();
+        else if (tokens[0] == "seebench")
+            bench::seeBench();
+        else if (tokens[0] == "fenbench")
+            bench::fenBench();
+        else if (tokens[0] == "startup")
+            bench::printStartup();
+        else if (tokens[0] == "prunenet")
+            pruneNet(tokens.size() > 1 ? tokens[1] : "");
+        else if (tokens[0] == "evalbatch") // e.g. "evalbatch positions.epd evals.txt 8"
+            nnue::evalBatch(tokens[1], tokens[2], tokens.size() > 3 ? stoi(tokens[3]) : 1);
         else if (tokens[0] == "perft")
         {
             int depth = stoi(tokens[1]);
@@ -1,7 +1,11 @@
 #pragma once
 
 #include <sstream>
+#include <fstream>
 #include <string>
+#include <string_view>
+#include <charconv>
+#include <array>
 #include <vector>
 #include <iostream>
 #include <algorithm>
@@ -9,7 +13,10 @@
 #include <cassert>
 #include <chrono>
 #include <unordered_map>
+#include <memory>
+#include <utility>
 #include "types.hpp"
+#include "allocations.hpp"
 
 #if defined(__GNUC__) // GCC, Clang, ICC
 inline u8 lsb(u64 b)
@@ -47,7 +54,14 @@ inline u8 poplsb(u64 &mask)
     return u8(s);
 }
 
+#if defined(__BMI2__)
+#include <immintrin.h>
+#endif
+
 inline u64 pdep(u64 val, u64 mask) {
+#if defined(__BMI2__)
+    return _pdep_u64(val, mask);
+#else
     u64 res = 0;
     for (u64 bb = 1; mask; bb += bb) {
         if (val & bb)
@@ -55,6 +69,7 @@ inline u64 pdep(u64 val, u64 mask) {
         mask &= mask - 1;
     }
     return res;
+#endif
 }
 
 inline Color oppColor(Color color)
@@ -63,9 +78,9 @@ inline Color oppColor(Color color)
     return color == Color::WHITE ? Color::BLACK : Color::WHITE;
 }
 
-inline Rank squareRank(Square square) { return (Rank)(square / 8); }
+constexpr Rank squareRank(Square square) { return (Rank)(square / 8); }
 
-inline File squareFile(Square square) { return (File)(square % 8); }
+constexpr File squareFile(Square square) { return (File)(square % 8); }
 
 const std::string SQUARE_TO_STR[64] = {
     "a1", "b1", "c1", "d1", "e1", "f1", "g1", "h1",
@@ -78,39 +93,20 @@ const std::string SQUARE_TO_STR[64] = {
     "a8", "b8", "c8", "d8", "e8", "f8", "g8", "h8",
 };
 
-inline Square strToSquare(std::string strSquare) {
+inline Square strToSquare(std::string_view strSquare) {
     return (strSquare[0] - 'a') + (strSquare[1] - '1') * 8;
 }
 
-std::unordered_map<char, Piece> CHAR_TO_PIECE = {
-    {'P', Piece::WHITE_PAWN},
-    {'N', Piece::WHITE_KNIGHT},
-    {'B', Piece::WHITE_BISHOP},
-    {'R', Piece::WHITE_ROOK},
-    {'Q', Piece::WHITE_QUEEN},
-    {'K', Piece::WHITE_KING},
-    {'p', Piece::BLACK_PAWN},
-    {'n', Piece::BLACK_KNIGHT},
-    {'b', Piece::BLACK_BISHOP},
-    {'r', Piece::BLACK_ROOK},
-    {'q', Piece::BLACK_QUEEN},
-    {'k', Piece::BLACK_KING},
-};
+// Lookup tables for the FEN parser and writer
+constexpr std::string_view PIECE_TO_CHAR = "PNBRQKpnbrqk."; // [piece], '.' for Piece::NONE
 
-std::unordered_map<Piece, char> PIECE_TO_CHAR = {
-    {Piece::WHITE_PAWN,   'P'},
-    {Piece::WHITE_KNIGHT, 'N'},
-    {Piece::WHITE_BISHOP, 'B'},
-    {Piece::WHITE_ROOK,   'R'},
-    {Piece::WHITE_QUEEN,  'Q'},
-    {Piece::WHITE_KING,   'K'},
-    {Piece::BLACK_PAWN,   'p'},
-    {Piece::BLACK_KNIGHT, 'n'},
-    {Piece::BLACK_BISHOP, 'b'},
-    {Piece::BLACK_ROOK,   'r'},
-    {Piece::BLACK_QUEEN,  'q'},
-    {Piece::BLACK_KING,   'k'}
-};
+constexpr auto CHAR_TO_PIECE = []() { // [char], Piece::NONE if not a piece
+    std::array<Piece, 256> table = {};
+    table.fill(Piece::NONE);
+    for (int piece = 0; piece < 12; piece++)
+        table[(u8)PIECE_TO_CHAR[piece]] = (Piece)piece;
+    return table;
+}();
 
 inline PieceType pieceToPieceType(Piece piece)
 {
@@ -176,6 +172,28 @@ inline void trim(std::string &str) {
     str = str.substr(first, (last - first + 1));
 }
 
+// Next space separated token of str starting at idx, empty if none, idx is moved past it
+inline std::string_view nextToken(std::string_view str, size_t &idx)
+{
+    while (idx < str.size() && (str[idx] == ' ' || str[idx] == '\t' || str[idx] == '\n' || str[idx] == '\r')) 
+        idx++;
+
+    size_t start = idx;
+    while (idx < str.size() && str[idx] != ' ' && str[idx] != '\t' && str[idx] != '\n' && str[idx] != '\r') 
+        idx++;
+
+    return str.substr(start, idx - start);
+}
+
+// Integer in str, or defaultValue if str isn't one
+template <typename T>
+inline T parseInt(std::string_view str, T defaultValue)
+{
+    T value;
+    auto [ptr, error] = std::from_chars(str.data(), str.data() + str.size(), value);
+    return error == std::errc() ? value : defaultValue;
+}
+
 inline std::vector<std::string> splitString(std::string &str, char delimiter)
 {
     trim(str);
@@ -211,24 +229,82 @@ inline void printBitboard(u64 bb)
 
 inline int charToInt(char myChar) { return myChar - '0'; }
 
-inline u64 shiftRight(u64 bb) {
+constexpr u64 shiftRight(u64 bb) {
 	return (bb << 1ULL) & 0xfefefefefefefefeULL;
 }
 
-inline u64 shiftLeft(u64 bb) {
+constexpr u64 shiftLeft(u64 bb) {
 	return (bb >> 1ULL) & 0x7f7f7f7f7f7f7f7fULL;
 }
 
-inline u64 shiftUp(u64 bb) { return bb << 8ULL; }
+constexpr u64 shiftUp(u64 bb) { return bb << 8ULL; }
 
-inline u64 shiftDown(u64 bb) { return bb >> 8ULL; }
+constexpr u64 shiftDown(u64 bb) { return bb >> 8ULL; }
 
-inline double ln(int x)
+inline double ln(double x)
 {
     assert(x > 0);
     return log(x);
 }
 
+// Natural log usable in constant expressions (std::log isn't constexpr before C++26)
+// x = m * 2^k with m in [1, 2), ln(m) = 2 * atanh((m - 1) / (m + 1)) as a series
+constexpr double constexprLn(double x)
+{
+    const double LN_2 = 0.693147180559945309417;
+    int k = 0;
+    while (x >= 2.0) { x /= 2.0; k++; }
+    while (x < 1.0)  { x *= 2.0; k--; }
+
+    double y = (x - 1.0) / (x + 1.0), ySquared = y * y;
+    double term = y, sum = 0;
+    for (int n = 1; n < 40; n += 2) // |y| <= 1/3
+    {
+        sum += term / n;
+        term *= ySquared;
+    }
+
+    return 2.0 * sum + k * LN_2;
+}
+
+// std::mt19937_64 usable in constant expressions, same output sequence
+// (used to generate tables at compile time with the same values they had when generated at startup)
+struct ConstexprMt19937_64
+{
+    static constexpr int N = 312, M = 156;
+    static constexpr u64 UPPER_MASK = 0xffffffff80000000ULL, LOWER_MASK = 0x7fffffffULL;
+
+    u64 state[N] = {};
+    int idx = N;
+
+    constexpr ConstexprMt19937_64(u64 seed)
+    {
+        state[0] = seed;
+        for (int i = 1; i < N; i++)
+            state[i] = 6364136223846793005ULL * (state[i - 1] ^ (state[i - 1] >> 62)) + i;
+    }
+
+    constexpr u64 operator()()
+    {
+        if (idx >= N)
+        {
+            for (int i = 0; i < N; i++)
+            {
+                u64 x = (state[i] & UPPER_MASK) | (state[(i + 1) % N] & LOWER_MASK);
+                state[i] = state[(i + M) % N] ^ (x >> 1) ^ (x & 1 ? 0xb5026f5aa96619e9ULL : 0);
+            }
+            idx = 0;
+        }
+
+        u64 x = state[idx++];
+        x ^= (x >> 29) & 0x5555555555555555ULL;
+        x ^= (x << 17) & 0x71d67fffeda60000ULL;
+        x ^= (x << 37) & 0xfff7eee000000000ULL;
+        x ^= x >> 43;
+        return x;
+    }
+};
+
 inline i16 min(i16 a, i16 b) {
     return a < b ? a : b;
 }
@@ -249,6 +325,31 @@ inline bool isNumber(std::string &s)
     return !s.empty() && it == s.end();
 }
 
+// Reads FENs from an EPD file, a file with 1 FEN per line, or a datagen output file ("<FEN> | <score> | <wdl>")
+// EPD operations are dropped and missing halfmove/fullmove counters are filled with "0 1"
+inline std::vector<std::string> readFens(std::string filePath)
+{
+    std::vector<std::string> fens;
+    std::ifstream file(filePath);
+    std::string line;
+
+    while (std::getline(file, line))
+    {
+        line = line.substr(0, line.find('|'));
+        std::vector<std::string> tokens = splitString(line, ' ');
+        if (tokens.size() < 4) continue;
+
+        std::string fen = tokens[0] + " " + tokens[1] + " " + tokens[2] + " " + tokens[3];
+        fen += tokens.size() >= 6 && isNumber(tokens[4]) && isNumber(tokens[5])
+               ? " " + tokens[4] + " " + tokens[5] 
+               : " 0 1";
+
+        fens.push_back(fen);
+    }
+
+    return fens;
+}
+
 std::string getRandomString(int length) {
     const std::string characters = "0123456789ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz";
     const int charactersLength = characters.length();
@@ -268,6 +369,80 @@ std::string getRandomString(int length) {
     return randomString;
 }
 
+// Stack with a capacity fixed at construction, its storage is allocated once and push/pop never reallocate
+// Copies get their own storage of the same capacity
+template <typename T>
+class FixedStack
+{
+    private:
+
+    std::unique_ptr<T[]> items = nullptr;
+    int capacity = 0, numItems = 0;
+
+    public:
+
+    FixedStack() = default;
+
+    inline FixedStack(int capacity) : items(new T[capacity]), capacity(capacity) {}
+
+    inline FixedStack(const FixedStack &other) { *this = other; }
+
+    inline FixedStack(FixedStack &&other) { *this = std::move(other); }
+
+    inline FixedStack &operator=(const FixedStack &other)
+    {
+        if (this == &other) return *this;
+
+        if (capacity != other.capacity)
+        {
+            items = other.capacity > 0 ? std::unique_ptr<T[]>(new T[other.capacity]) : nullptr;
+            capacity = other.capacity;
+        }
+
+        numItems = other.numItems;
+        std::copy(other.items.get(), other.items.get() + numItems, items.get());
+        return *this;
+    }
+
+    inline FixedStack &operator=(FixedStack &&other)
+    {
+        items = std::move(other.items);
+        capacity = std::exchange(other.capacity, 0);
+        numItems = std::exchange(other.numItems, 0);
+        return *this;
+    }
+
+    inline bool allocated() { return items != nullptr; }
+
+    inline int size() { return numItems; }
+
+    inline void clear() { numItems = 0; }
+
+    inline void push_back(const T &item)
+    {
+        assert(numItems < capacity);
+        items[numItems++] = item;
+    }
+
+    inline void pop_back()
+    {
+        assert(numItems > 0);
+        numItems--;
+    }
+
+    inline T &back()
+    {
+        assert(numItems > 0);
+        return items[numItems - 1];
+    }
+
+    inline T &operator[](int i)
+    {
+        assert(i >= 0 && i < numItems);
+        return items[i];
+    }
+};
+
 #include "move.hpp"
 
 inline std::pair<Move, i32> incrementalSort(MovesList &moves, std::array<i32, 256> &movesScores, int i)
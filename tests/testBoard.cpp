@@ -2,6 +2,11 @@
 #include "../src/board.hpp"
 #include "../src/perft.hpp"
 
+Board board; // uci's board
+
+#include "../src/search.hpp"
+#include "../src/uci.hpp"
+
 int failed = 0, passed = 0;
 const std::string POSITION2_KIWIPETE = "r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R w KQkq - ";
 const std::string POSITION3 = "8/2p5/3p4/KP5r/1R3p1k/8/4P1P1/8 w - - ";
@@ -186,7 +191,7 @@ int main()
     test("fen is what we expect after making moves", board.fen(), expectedFen);
     test("zobristHash is what we expect after making moves", 
          board.getZobristHash(), 
-         Board(expectedFen).getZobristHash());
+         BasicBoard<Tracking::HASH>(expectedFen).getZobristHash()); // hash only, board still undoes its moves below
 
     // Test undoing moves and zobrist hash
     for (int i = 5; i >= 0; i--)
@@ -222,7 +227,82 @@ int main()
     board.makeMove("d7d5");
     test("Zobrist hash equals (making 3 moves vs from fen)", 
         board.getZobristHash(), 
-        Board("1r2k2r/ppp1pppp/8/2PpP2P/8/8/4K3/R6R w k d6 0 3").getZobristHash());
+        BasicBoard<Tracking::HASH>("1r2k2r/ppp1pppp/8/2PpP2P/8/8/4K3/R6R w k d6 0 3").getZobristHash());
+
+    // Hash only board: same zobrist hash as the main board, without touching the NNUE accumulators
+    {
+        board = Board("r3k2r/pppppppp/8/2P1P2P/8/8/8/R3K2R b KQkq - 0 1");
+        BasicBoard<Tracking::HASH> hashBoard = BasicBoard<Tracking::HASH>("r3k2r/pppppppp/8/2P1P2P/8/8/8/R3K2R b KQkq - 0 1");
+        const void *accumulatorBefore = nnue::mainNet.currentAccumulator;
+
+        for (std::string move : {"a8b8", "e1e2", "d7d5", "c5d6"})
+        {
+            board.makeMove(move);
+            hashBoard.makeMove(move);
+        }
+
+        test("Hash only board zobrist hash equals main board's", hashBoard.getZobristHash(), board.getZobristHash());
+        test("Hash only board fen equals main board's", hashBoard.fen(), board.fen());
+
+        board.undoMove();
+        hashBoard.undoMove();
+        test("Hash only board zobrist hash equals main board's after undo", hashBoard.getZobristHash(), board.getZobristHash());
+
+        for (int i = 0; i < 3; i++)
+            board.undoMove();
+        test("Main board accumulator is the same after make/undo on hash only board", 
+             (const void*)nnue::mainNet.currentAccumulator, accumulatorBefore);
+    }
+
+    // Upcoming repetition (cuckoo tables)
+    board = Board(START_FEN);
+    for (std::string move : {"g1f3", "g8f6", "f3g1"})
+        board.makeMove(move);
+    test("Upcoming repetition Nf6-g8 within the search", board.hasUpcomingRepetition(4), true);
+    test("No upcoming repetition if the repeated position is before the root", board.hasUpcomingRepetition(3), false);
+    board.makeMove("b8c6");
+    test("No upcoming repetition if the earlier positions are 2 moves away (Nf3-g1 and Nc6-b8)", 
+         board.hasUpcomingRepetition(10), false);
+
+    // Irreversible moves: only the positions since the last pawn move or capture are checked
+    board = Board(START_FEN);
+    for (std::string move : {"e2e4", "g8f6", "g1f3", "f6g8"})
+        board.makeMove(move);
+    test("Upcoming repetition Nf3-g1 of the position right after a pawn push", board.hasUpcomingRepetition(10), true);
+    for (std::string move : {"d2d4", "g8f6", "f3g1"})
+        board.makeMove(move);
+    test("Halfmove clock after pawn push", board.fen().ends_with(" 2 4"), true);
+    test("No upcoming repetition Nf6-g8 of a position before a pawn push", board.hasUpcomingRepetition(10), false);
+
+    board = Board("4k3/8/8/8/8/8/8/R3K3 w - - 0 1");
+    for (std::string move : {"a1a4", "e8d8", "e1e2", "d8e8"})
+        board.makeMove(move);
+    test("Upcoming repetition Ke2-e1", board.hasUpcomingRepetition(10), true);
+    if (!board.inCheck()) board.makeNullMove();
+    test("No upcoming repetition across a null move", board.hasUpcomingRepetition(10), false);
+
+    // The rook went a1-a3-h3-h1, going back to a1 directly is blocked by our king on e1
+    for (std::string fen : {"4k3/8/8/8/8/8/8/R3K3 b - - 0 1", "4k3/8/8/8/8/8/4K3/R7 b - - 0 1"})
+    {
+        board = Board(fen);
+        for (std::string move : {"e8d8", "a1a3", "d8c8", "a3h3", "c8d8", "h3h1", "d8e8"})
+            board.makeMove(move);
+        test("Upcoming repetition Rh1-a1 only if not blocked " + fen, 
+             board.hasUpcomingRepetition(10), 
+             board.pieceAt(strToSquare("e1")) == Piece::NONE);
+    }
+
+    // Moves list piece types match the board
+    for (std::string fen : {POSITION2_KIWIPETE, POSITION3, POSITION4, POSITION5, (std::string)"rnbqkbnr/ppp1p1pp/8/3pPp2/8/8/PPPP1PPP/RNBQKBNR w KQkq f6 0 3"})
+    {
+        board = Board(fen);
+        MovesList moves = board.pseudolegalMoves();
+        bool allMatch = true;
+        for (int i = 0; i < moves.size(); i++)
+            allMatch &= moves.pieceType(i) == board.pieceTypeAt(moves[i].from())
+                        && moves.captured(i) == board.captured(moves[i]);
+        test("Moves list piece types and captured piece types " + fen, allMatch, true);
+    }
 
     // Test illegal move
     board = Board("rnb1kbnr/pppp1ppp/8/4p1q1/3P4/1P6/P1P1PPPP/RNBQKBNR w KQkq - 1 3");
@@ -230,6 +310,32 @@ int main()
     board.makeMove("e1d2"); // illegal
     test("Zobrist hash equals after illegal move", zobHash, board.getZobristHash());
 
+    // Long game: uci position with more than MAX_GAME_PLIES moves plays all of them
+    // The reference board makes them without trimming (1100 moves fit in its stacks)
+    {
+        std::string positionCommand = "position startpos moves e2e4 e7e5";
+        Board referenceBoard = Board(START_FEN);
+        referenceBoard.makeMove("e2e4");
+        referenceBoard.makeMove("e7e5");
+
+        const std::string SHUFFLE[4] = {"g1f3", "g8f6", "f3g1", "f6g8"};
+        for (int i = 0; i < 1098; i++)
+        {
+            positionCommand += " " + SHUFFLE[i % 4];
+            referenceBoard.makeMove(SHUFFLE[i % 4]);
+        }
+
+        std::vector<std::string> tokens = splitString(positionCommand, ' ');
+        uci::position(tokens);
+
+        test("uci position 1100 moves fen", ::board.fen(), referenceBoard.fen());
+        test("uci position 1100 moves fen", ::board.fen(), 
+             (std::string)"rnbqkb1r/pppp1ppp/5n2/4p3/4P3/5N2/PPPP1PPP/RNBQKB1R w KQkq - 1098 551");
+        test("uci position 1100 moves isRepetition()", ::board.isRepetition(), referenceBoard.isRepetition());
+        test("uci position 1100 moves hasUpcomingRepetition()", 
+             ::board.hasUpcomingRepetition(10), referenceBoard.hasUpcomingRepetition(10));
+    }
+
     // Perft's
 
     board = Board(START_FEN);
@@ -254,6 +360,21 @@ int main()
     test("perft(1) position 5", perft::perftBench(boardPos5, 1), 44ULL);
     test("perft(5) position 2 kiwipete", perft::perftBench(boardPos2, 5), 193690690ULL);
 
+    for (std::string fen : {START_FEN, POSITION2_KIWIPETE, POSITION3, POSITION4, POSITION4_MIRRORED, POSITION5})
+    {
+        Board boardAttacks = Board(fen);
+        for (Color color : {Color::WHITE, Color::BLACK})
+        {
+            uint64_t expected = 0;
+            for (Square sq = 0; sq < 64; sq++)
+                if (boardAttacks.isSquareAttacked(sq, color)) 
+                    expected |= 1ULL << sq;
+
+            test("attacks::allAttacks() " + fen + (color == Color::WHITE ? " white" : " black"), 
+                 attacks::allAttacks(boardAttacks, color), expected);
+        }
+    }
+
     std::cout << std::endl;
     std::cout << "Tests passed: " << passed << std::endl;
     std::cout << "Tests failed: " << failed << std::endl;
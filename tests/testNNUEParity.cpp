@@ -0,0 +1,290 @@
+#include <iostream>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <random>
+#include <chrono>
+#include <cmath>
+#include "../src/board.hpp"
+#include "../src/nnue.hpp"
+#include "../src/batch_eval.hpp"
+
+// NNUE parity harness
+// Every kernel path (inlined full width, permuted copy, pointer kernels for pruned widths, batch)
+// must match a plain int reference bit for bit, incrementally updated accumulators must match refreshed ones
+// after random make/undo sequences, and the int reference must be within 1 cp of a float reference
+// Also reports the throughput of each path
+
+using A = nnue::MainArch;
+
+const int WALK_PLIES = 20000;
+const u32 SEED = 12345;
+
+const std::vector<std::string> START_FENS = {
+    START_FEN,
+    "r1bqkbnr/pppp1ppp/2n5/4p3/4P3/5N2/PPPP1PPP/RNBQKB1R w KQkq - 2 3",
+    "r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R w KQkq - 0 1",
+    "8/2p5/3p4/KP5r/1R3p1k/8/4P1P1/8 w - - 0 1",
+    "r3k2r/Pppp1ppp/1b3nbN/nP6/BBP1P3/q4N2/Pp1P2PP/R2Q1RK1 w kq - 0 1",
+    "rnbq1k1r/pp1Pbppp/2p5/8/2B5/8/PPP1NnPP/RNBQK2R w KQ - 1 8",
+    "8/8/4k3/8/2p5/8/B2P2K1/8 w - - 0 1",
+    "4k3/1P6/8/8/8/8/K7/8 w - - 0 1"
+};
+
+int failed = 0, passed = 0;
+
+inline void check(bool ok, std::string what)
+{
+    if (ok)
+        passed++;
+    else
+    {
+        failed++;
+        if (failed <= 20) std::cout << "FAILED " << what << std::endl;
+    }
+}
+
+namespace reference {
+
+// Accumulator of the given neurons, computed from scratch from the raw net in i32
+inline void accumulator(const nnue::NN<A> *nn, const std::vector<u16> &neurons, Board &board,
+                        std::vector<i32> &white, std::vector<i32> &black)
+{
+    white.assign(neurons.size(), 0);
+    black.assign(neurons.size(), 0);
+
+    for (size_t i = 0; i < neurons.size(); i++)
+        white[i] = black[i] = nn->featureBiases[neurons[i]];
+
+    for (Square sq = 0; sq < 64; sq++)
+    {
+        Piece piece = board.pieceAt(sq);
+        if (piece == Piece::NONE) continue;
+
+        int color = (int)pieceColor(piece), pieceType = (int)pieceToPieceType(piece);
+        int whiteIdx = color * 384 + pieceType * 64 + sq;
+        int blackIdx = !color * 384 + pieceType * 64 + (sq ^ 56);
+
+        for (size_t i = 0; i < neurons.size(); i++)
+        {
+            white[i] += nn->featureWeights[whiteIdx * A::HIDDEN_SIZE + neurons[i]];
+            black[i] += nn->featureWeights[blackIdx * A::HIDDEN_SIZE + neurons[i]];
+        }
+    }
+}
+
+inline i32 evalInt(const nnue::NN<A> *nn, const std::vector<u16> &neurons, Board &board)
+{
+    std::vector<i32> white, black;
+    accumulator(nn, neurons, board, white, black);
+
+    std::vector<i32> &us = board.sideToMove() == Color::WHITE ? white : black;
+    std::vector<i32> &them = board.sideToMove() == Color::WHITE ? black : white;
+
+    i32 sum = 0;
+    for (size_t i = 0; i < neurons.size(); i++)
+    {
+        sum += std::clamp<i32>(us[i], 0, A::QA) * nn->outputWeights[neurons[i]];
+        sum += std::clamp<i32>(them[i], 0, A::QA) * nn->outputWeights[A::HIDDEN_SIZE + neurons[i]];
+    }
+
+    return (sum / nnue::NORMALIZATION_K + nn->outputBias[0]) * A::SCALE / (A::QA * A::QB);
+}
+
+// Dequantized weights, floating point math
+inline double evalFloat(const nnue::NN<A> *nn, const std::vector<u16> &neurons, Board &board)
+{
+    std::vector<i32> white, black;
+    accumulator(nn, neurons, board, white, black);
+
+    std::vector<i32> &us = board.sideToMove() == Color::WHITE ? white : black;
+    std::vector<i32> &them = board.sideToMove() == Color::WHITE ? black : white;
+
+    double sum = (double)nn->outputBias[0] / (A::QA * A::QB);
+    for (size_t i = 0; i < neurons.size(); i++)
+    {
+        sum += std::clamp<double>((double)us[i] / A::QA, 0, 1) * nn->outputWeights[neurons[i]] / A::QB;
+        sum += std::clamp<double>((double)them[i] / A::QA, 0, 1) * nn->outputWeights[A::HIDDEN_SIZE + neurons[i]] / A::QB;
+    }
+
+    return sum / nnue::NORMALIZATION_K * A::SCALE;
+}
+
+}
+
+inline i32 engineEval(Board &board) {
+    return nnue::evaluate(board.sideToMove(), std::popcount(board.occupancy()));
+}
+
+inline double secondsSince(std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+// Random walk with random undos from the start positions
+// After every make/undo, the incremental accumulator is compared to the reference one
+// Returns the visited positions
+inline std::vector<std::string> randomWalk(const std::vector<u16> &neurons, std::string pathName)
+{
+    const nnue::NN<A> *nn = nnue::mainNet.raw();
+    std::mt19937 gen(SEED);
+    std::vector<std::string> fens;
+    std::vector<i32> white, black;
+
+    Board board = Board(START_FENS[0]);
+    int plies = 0, startIdx = 0;
+
+    for (int step = 0; step < WALK_PLIES; step++)
+    {
+        MovesList moves = board.pseudolegalMoves();
+        bool undo = plies > 0 && gen() % 4 == 0;
+        bool moved = false;
+
+        if (!undo)
+            for (int tries = 0; tries < 16 && moves.size() > 0 && !moved; tries++)
+                moved = board.makeMove(moves[gen() % moves.size()]);
+
+        if (moved)
+            plies++;
+        else if (plies > 0)
+        {
+            board.undoMove();
+            plies--;
+        }
+
+        // Restart from another position when the game ends or gets long
+        if ((!moved && plies == 0) || plies >= 200)
+        {
+            board = Board(START_FENS[++startIdx % START_FENS.size()]);
+            plies = 0;
+        }
+
+        reference::accumulator(nn, neurons, board, white, black);
+        bool accumulatorsMatch = true;
+        for (size_t i = 0; i < neurons.size(); i++)
+            accumulatorsMatch &= nnue::mainNet.currentAccumulator->white[i] == white[i]
+                                 && nnue::mainNet.currentAccumulator->black[i] == black[i];
+
+        check(accumulatorsMatch, pathName + " incremental accumulator " + board.fen());
+        check(engineEval(board) == reference::evalInt(nn, neurons, board), pathName + " incremental eval " + board.fen());
+
+        fens.push_back(board.fen());
+    }
+
+    return fens;
+}
+
+// Checks and times one kernel path, the current packed net, whose neurons are 'neurons' of the raw net
+inline void testPath(std::string pathName, const std::vector<u16> &neurons)
+{
+    const nnue::NN<A> *nn = nnue::mainNet.raw();
+
+    std::vector<std::string> fens = randomWalk(neurons, pathName);
+
+    std::vector<i32> referenceEvals;
+    for (std::string &fen : fens)
+    {
+        Board board = Board(fen);
+        referenceEvals.push_back(reference::evalInt(nn, neurons, board));
+    }
+
+    // Refresh
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < fens.size(); i++)
+    {
+        Board board = Board(fens[i]);
+        check(engineEval(board) == referenceEvals[i], pathName + " refresh eval " + fens[i]);
+    }
+    double refreshSeconds = secondsSince(start);
+
+    // Batch
+    std::vector<nnue::CompactPosition> positions(fens.size());
+    std::vector<i32> batchEvals(fens.size());
+    for (size_t i = 0; i < fens.size(); i++)
+        nnue::toCompactPosition(fens[i], positions[i]);
+
+    start = std::chrono::steady_clock::now();
+    nnue::mainNet.evaluateBatch(positions.data(), batchEvals.data(), positions.size());
+    double batchSeconds = secondsSince(start);
+
+    for (size_t i = 0; i < fens.size(); i++)
+        check(batchEvals[i] == referenceEvals[i], pathName + " batch eval " + fens[i]);
+
+    // Incremental: make, eval, undo over every legal move of the first 1000 positions
+    u64 incrementalEvals = 0;
+    i64 evalsSum = 0; // printed, so the evals can't be optimized away
+    start = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < std::min<size_t>(fens.size(), 1000); i++)
+    {
+        Board board = Board(fens[i]);
+        MovesList moves = board.pseudolegalMoves();
+        for (int j = 0; j < moves.size(); j++)
+        {
+            if (!board.makeMove(moves[j])) continue;
+            evalsSum += engineEval(board);
+            incrementalEvals++;
+            board.undoMove();
+        }
+    }
+    double incrementalSeconds = secondsSince(start);
+
+    std::cout << pathName << " (width " << nnue::mainNet.packed.width << "): "
+              << (u64)(fens.size() / refreshSeconds) << " refresh evals/s, "
+              << (u64)(incrementalEvals / incrementalSeconds) << " make+eval+undo/s, "
+              << (u64)(fens.size() / batchSeconds) << " batch evals/s"
+              << ", incremental evals sum " << evalsSum << std::endl;
+}
+
+int main()
+{
+    attacks::init();
+    nnue::init();
+
+    const nnue::NN<A> *nn = nnue::mainNet.raw();
+
+    std::vector<u16> allNeurons(A::HIDDEN_SIZE);
+    for (int i = 0; i < A::HIDDEN_SIZE; i++)
+        allNeurons[i] = i;
+
+    // Float reference vs int reference
+    {
+        std::vector<std::string> fens = randomWalk(allNeurons, "full");
+        double maxDiff = 0;
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        for (std::string &fen : fens)
+        {
+            Board board = Board(fen);
+            maxDiff = std::max<double>(maxDiff, fabs(reference::evalFloat(nn, allNeurons, board) - reference::evalInt(nn, allNeurons, board)));
+        }
+        double seconds = secondsSince(start);
+
+        check(maxDiff < 1, "float reference vs int reference, max diff " + std::to_string(maxDiff));
+        std::cout << "float vs int reference on " << fens.size() << " positions: max diff " << maxDiff << " cp"
+                  << ", " << (u64)(fens.size() / seconds) << " reference evals/s (float + int)" << std::endl;
+    }
+
+    // Inlined full width kernels
+    nnue::mainNet.pack();
+    testPath("full", allNeurons);
+
+    // Reversed neuron order, full width: permuted copy of the weights, still inlined kernels
+    std::array<u16, A::HIDDEN_SIZE> reversed;
+    for (int i = 0; i < A::HIDDEN_SIZE; i++)
+        reversed[i] = A::HIDDEN_SIZE - 1 - i;
+
+    nnue::mainNet.permuteNeurons(reversed, A::HIDDEN_SIZE);
+    testPath("permuted", std::vector<u16>(reversed.begin(), reversed.end()));
+
+    // Pruned widths: kernels through pointers
+    for (u16 width : {A::HIDDEN_SIZE - 32, A::HIDDEN_SIZE / 2, 32})
+    {
+        nnue::mainNet.permuteNeurons(reversed, width);
+        testPath("pointer kernel", std::vector<u16>(reversed.begin(), reversed.begin() + width));
+    }
+
+    nnue::mainNet.pack();
+
+    std::cout << "Passed: " << passed << std::endl;
+    std::cout << "Failed: " << failed << std::endl;
+
+    return failed > 0;
+}